@@ -0,0 +1,23 @@
+#!/bin/sh
+# times shaders/blob.glsl as a native pass against its GLSL code on llvmpipe,
+# flying the same camera path at the same size.
+# usage: native/bench.sh <build dir> [frame size]
+set -e
+build=${1:?usage: $0 <build dir> [frame size]}
+size=${2:-800x600}
+root=$(dirname "$0")/..
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+{ echo "---native scene libblob.so"; cat "$root/shaders/blob.glsl"; } > "$tmp/blob.glsl"
+cp "$build/libblob.so" "$tmp/"
+printf '0 0 0 0 0 0\n10 0 0 0 0 0\n' > "$tmp/camera.path"
+
+run() {
+    LIBGL_ALWAYS_SOFTWARE=1 "$build/fiddle" --play --fixed --size "$size" \
+        --camera "$tmp/camera.path" "$@" "$tmp/blob.glsl" | grep '^timing:'
+}
+echo "llvmpipe:"
+run --no-native
+echo "native:"
+run
@@ -0,0 +1,130 @@
+// the scene of shaders/blob.glsl as a native pass: a floor, a wall and a
+// rotated box with soft shadows and ambient occlusion. a row of LANES pixels
+// is marched at once, lanes that are done keep their result while the others
+// go on, and each loop ends as soon as no lane is left
+#include "native.hpp"
+#include "simd.hpp"
+#include <algorithm>
+
+
+using namespace simd;
+
+
+namespace {
+
+
+const float E = 0.0001f;
+
+
+struct Scene {
+    float c1, s1; // the two rotations of the box
+    float c2, s2;
+    float light[3];
+};
+
+
+Float map(Scene const& s, Vec3 const& p) {
+    Float d = min(p.y + 3.0f, 2.0f - p.z);
+    Float x = s.c1 * p.x + s.s1 * p.z;
+    Float z = s.c1 * p.z - s.s1 * p.x;
+    Float y = s.c2 * p.y - s.s2 * x;
+    x = s.c2 * x + s.s2 * p.y;
+    return min(d, max(max(abs(x), abs(y)), abs(z)) - 1.0f);
+}
+
+
+Vec3 march(Scene const& s, Vec3 const& dir) {
+    Vec3  pos    = { splat(0), splat(0), splat(-9) };
+    Vec3  p      = pos;
+    Float t      = splat(0);
+    Float t_prev = splat(0);
+    Float factor = splat(0.9f);
+    Mask  live   = Mask{} - 1;
+    for (int i = 0; i < 100 && any(live); ++i) {
+        p = select(live, pos + dir * t, p);
+        Float d = map(s, p);
+        // overshot: go back and take smaller steps
+        Mask inside = live & (d < 0.0f);
+        t      = select(inside, t_prev, t);
+        factor = select(inside, factor * 0.9f, factor);
+        live   = live & (inside | (d > E));
+        Mask step = live & ~inside;
+        t_prev = select(step, t, t_prev);
+        t      = select(step, t + d * factor, t);
+    }
+    return p;
+}
+
+
+Float light(Scene const& s, Vec3 const& p) {
+    Float d = map(s, p);
+    Vec3 n = normalize({
+        map(s, { p.x + E, p.y, p.z }) - d,
+        map(s, { p.x, p.y + E, p.z }) - d,
+        map(s, { p.x, p.y, p.z + E }) - d });
+    Vec3 l = { splat(s.light[0]), splat(s.light[1]), splat(s.light[2]) };
+    Float dp = dot(n, l);
+    Float c  = max(dp, splat(0));
+
+    // ambient occlusion
+    Float a = splat(0);
+    Vec3  o = p;
+    for (int i = 0; i < 10; ++i) {
+        a = max(a, map(s, o));
+        o = o + n * splat(0.05f);
+    }
+    Float q  = 1.0f - a;
+    Float ao = 0.4f * (1.0f - q * q * q);
+
+    // soft shadows
+    Mask  lit  = dp > 0.0f;
+    Mask  live = lit;
+    Float m    = splat(1);
+    Float t    = splat(E);
+    for (int i = 0; i < 100 && any(live); ++i) {
+        Float h = map(s, p + l * t);
+        t    = select(live, t + h * 0.9f, t);
+        m    = select(live, min(m, 10.0f * h / t), m);
+        live = live & (m >= E);
+    }
+    Float shadow;
+    for (int i = 0; i < LANES; ++i) shadow[i] = std::pow(std::min(std::max(m[i], 0.0f), 1.0f), 0.8f);
+    return select(lit, c * shadow, c) + ao;
+}
+
+
+} // namespace
+
+
+extern "C" void fiddle_native_render(native::Frame const* f, native::Tile const* tile) {
+    Scene s;
+    float r1 = native::variable(*f, "r1", 5);
+    float r2 = native::variable(*f, "r2", 5);
+    s.c1 = std::cos(r1);
+    s.s1 = std::sin(r1);
+    s.c2 = std::cos(r2);
+    s.s2 = std::sin(r2);
+    float len = std::sqrt(1.0f + 4.0f + 0.09f);
+    s.light[0] = 1.0f / len;
+    s.light[1] = 2.0f / len;
+    s.light[2] = -0.3f / len;
+
+    float rx = f->resolution[0];
+    float ry = f->resolution[1];
+    for (int y = 0; y < tile->h; ++y) {
+        float fy = tile->y + y + 0.5f + f->offset[1];
+        for (int x = 0; x < tile->w; x += LANES) {
+            Float fx;
+            for (int i = 0; i < LANES; ++i) fx[i] = tile->x + x + i + 0.5f + f->offset[0];
+            Vec3 dir = normalize({ fx / rx * 2.0f - 1.0f, splat(fy / rx * 2.0f - ry / rx), splat(1) });
+            Float c = light(s, march(s, dir));
+            float* out = tile->rgba + (y * tile->stride + x) * 4;
+            for (int i = 0; i < std::min<int>(LANES, tile->w - x); ++i) {
+                out[i * 4 + 0] = c[i] * 0.7f;
+                out[i * 4 + 1] = c[i] * 0.7f;
+                out[i * 4 + 2] = c[i];
+                out[i * 4 + 3] = 1;
+            }
+        }
+    }
+}
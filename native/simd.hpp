@@ -0,0 +1,68 @@
+#pragma once
+// lanes of floats for native kernels, on GCC and clang vector extensions.
+// with -mavx2 a Float is 8 lanes in one register, with -mavx512f it is 16
+#include <cmath>
+#include <cstdint>
+#include <immintrin.h>
+
+
+namespace simd {
+
+
+#ifdef __AVX512F__
+enum { LANES = 16 };
+#else
+enum { LANES = 8 };
+#endif
+
+typedef float   Float __attribute__((vector_size(LANES * sizeof(float))));
+typedef int32_t Mask  __attribute__((vector_size(LANES * sizeof(int32_t)))); // 0 or -1 per lane
+
+
+inline Float splat(float f) { return Float{} + f; }
+inline Float select(Mask m, Float a, Float b) { return m ? a : b; }
+inline Float min(Float a, Float b) { return a < b ? a : b; }
+inline Float max(Float a, Float b) { return a > b ? a : b; }
+inline Float abs(Float a) { return a < 0.0f ? -a : a; }
+
+inline Float sqrt(Float a) {
+#if defined(__AVX512F__)
+    return (Float) _mm512_maskz_sqrt_ps(0xffff, (__m512) a);
+#elif defined(__AVX__)
+    return (Float) _mm256_sqrt_ps((__m256) a);
+#else
+    Float r;
+    for (int i = 0; i < LANES; ++i) r[i] = std::sqrt(a[i]);
+    return r;
+#endif
+}
+
+inline bool any(Mask m) {
+#if defined(__AVX512F__)
+    return _mm512_test_epi32_mask((__m512i) m, (__m512i) m) != 0;
+#elif defined(__AVX__)
+    return _mm256_movemask_ps((__m256) m) != 0;
+#else
+    for (int i = 0; i < LANES; ++i) {
+        if (m[i]) return true;
+    }
+    return false;
+#endif
+}
+
+
+struct Vec3 {
+    Float x, y, z;
+};
+
+inline Vec3 operator+(Vec3 const& a, Vec3 const& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Vec3 operator-(Vec3 const& a, Vec3 const& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Vec3 operator*(Vec3 const& a, Float f) { return { a.x * f, a.y * f, a.z * f }; }
+inline Float dot(Vec3 const& a, Vec3 const& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 normalize(Vec3 const& a) { return a * (1.0f / sqrt(dot(a, a))); }
+inline Vec3 select(Mask m, Vec3 const& a, Vec3 const& b) {
+    return { select(m, a.x, b.x), select(m, a.y, b.y), select(m, a.z, b.z) };
+}
+
+
+} // namespace
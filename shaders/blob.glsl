@@ -82,6 +82,7 @@ float light(vec3 p) {
 		float m = 1.0;
 		float t = E;
 		for (int i = 0; i < 100; i++) {
+			$cost();
 			float d = map(o + t * light_dir);
 			t += d * 0.9;
 			m = min(m, 10.0 * d / t);
@@ -97,7 +98,7 @@ float light(vec3 p) {
 
 void main() {
 
-	vec3 dir = vec3(gl_FragCoord.xy / iResolution.x * 2.0
+	vec3 dir = vec3((gl_FragCoord.xy + iOffset) / iResolution.x * 2.0
 		- vec2(1.0, iResolution.y / iResolution.x), 1.0);
     dir = eye_dir * dir;
 	dir = normalize(dir);
@@ -111,7 +112,7 @@ void main() {
     float t_prev = 0;
     float factor = 0.9;
 	for (int i = 0; i < 100; i++) {
-
+		$cost();
 		p = pos + dir * t;
 		float d = map(p);
 
@@ -0,0 +1,73 @@
+---pass scene format=rgba16f mips
+
+float map(vec3 p) {
+    float d = p.y + 1.0;
+    p.xz = mod(p.xz + 2.0, 4.0) - 2.0;
+    return min(d, length(p) - $radius(0.2, 1.5));
+}
+
+vec3 normal(vec3 p) {
+    float d = map(p);
+    return normalize(vec3(
+        map(p + vec3(0.001, 0.0, 0.0)) - d,
+        map(p + vec3(0.0, 0.001, 0.0)) - d,
+        map(p + vec3(0.0, 0.0, 0.001)) - d));
+}
+
+void main() {
+    vec3 dir = normalize(iEye * vec3((gl_FragCoord.xy + iOffset) / iResolution.x * 2.0
+                                     - vec2(1.0, iResolution.y / iResolution.x), 1.5));
+    vec3 pos = iPos * 0.05;
+    float t = 0.0;
+    for (int i = 0; i < 100 && t < 100.0; i++) {
+        float d = map(pos + dir * t);
+        if (d < 0.001) break;
+        t += d;
+    }
+    vec3 p = pos + dir * t;
+    vec3 col = vec3(0.0);
+    if (t < 100.0) {
+        vec3 n = normal(p);
+        col = vec3(0.6, 0.7, 1.0) * max(dot(n, normalize(vec3(1.0, 2.0, -1.0))), 0.05);
+        if (p.y > -0.9) col += vec3(4.0, 2.0, 0.5) * pow(max(n.y, 0.0), 8.0);
+    }
+    gl_FragColor = vec4(col, 1.0);
+}
+
+---pass bright in=scene size=0.5 format=rgba16f mips
+
+void main() {
+    vec3 c = texture(iChannel0, gl_FragCoord.xy / iTileResolution).rgb;
+    gl_FragColor = vec4(max(c - vec3($threshold(0, 2)), 0.0), 1.0);
+}
+
+---pass blur_x in=bright size=0.25 format=rgba16f
+
+void main() {
+    vec2 uv = gl_FragCoord.xy / iTileResolution;
+    vec3 c = vec3(0.0);
+    for (int i = -4; i <= 4; i++) {
+        c += texture(iChannel0, uv + vec2(i, 0) / iTileResolution).rgb * (5.0 - abs(float(i)));
+    }
+    gl_FragColor = vec4(c / 25.0, 1.0);
+}
+
+---pass blur_y in=blur_x size=0.25 format=rgba16f
+
+void main() {
+    vec2 uv = gl_FragCoord.xy / iTileResolution;
+    vec3 c = vec3(0.0);
+    for (int i = -4; i <= 4; i++) {
+        c += texture(iChannel0, uv + vec2(0, i) / iTileResolution).rgb * (5.0 - abs(float(i)));
+    }
+    gl_FragColor = vec4(c / 25.0, 1.0);
+}
+
+---pass final in=scene,blur_y format=rgba8
+
+void main() {
+    vec2 uv = gl_FragCoord.xy / iTileResolution;
+    vec3 c = texture(iChannel0, uv).rgb + texture(iChannel1, uv).rgb * $strength(0, 4);
+    c /= c + vec3(1.0);
+    gl_FragColor = vec4(c, 1.0);
+}
@@ -177,7 +177,8 @@ vec3 trace(vec3 o, vec3 d) {
 
 
 void main() {
-    vec3 dir = normalize(iEye * vec3((gl_FragCoord.xy + rand_dir(gl_FragCoord.xyy).xy) / iResolution.x * 2.0 - vec2(1.0, iResolution.y / iResolution.x), 1.5));
+    vec2 frag = gl_FragCoord.xy + iOffset;
+    vec3 dir = normalize(iEye * vec3((frag + rand_dir(frag.xyy).xy) / iResolution.x * 2.0 - vec2(1.0, iResolution.y / iResolution.x), 1.5));
     gl_FragColor = vec4(trace(iPos, dir), 1.0) + texelFetch(iChannel0, ivec2(gl_FragCoord.xy), 0);
 }
 
@@ -0,0 +1,20 @@
+#include "clock.hpp"
+#include <SDL2/SDL.h>
+
+
+void Clock::reset() {
+    m_ticks = SDL_GetTicks();
+    seek(0);
+}
+
+
+void Clock::step() {
+    seek(m_frame + 1);
+}
+
+
+void Clock::seek(int frame) {
+    m_frame = frame;
+    if (m_fixed) m_time = float(m_start + double(m_frame) / m_fps);
+    else m_time = m_start + (SDL_GetTicks() - m_ticks) * 0.001f;
+}
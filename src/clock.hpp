@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+
+
+// the time shaders see as iTime. in real time mode it follows the wall
+// clock, in fixed mode frame n is at start + n / fps however long frames
+// take, so renders and benchmark runs are reproducible
+class Clock {
+public:
+    void set_fixed(float fps) {
+        m_fixed = true;
+        m_fps   = fps;
+    }
+    void set_range(float start, float end) {
+        m_start = start;
+        m_end   = end;
+    }
+
+    void reset();         // back to frame 0
+    void step();          // advance one frame
+    void seek(int frame);
+    // take the time from elsewhere, like a replayed session
+    void set(int frame, float time) {
+        m_frame = frame;
+        m_time  = time;
+    }
+
+    bool  fixed() const { return m_fixed; }
+    int   frame() const { return m_frame; }
+    float time() const { return m_time; }
+    bool  ended() const { return m_time > m_end; }
+
+private:
+    bool     m_fixed = false;
+    float    m_fps   = 30;
+    float    m_start = 0;
+    float    m_end   = INFINITY;
+    int      m_frame = 0;
+    float    m_time  = 0;
+    uint32_t m_ticks = 0; // at frame 0
+};
@@ -0,0 +1,397 @@
+#include "farm.hpp"
+#include "options.hpp"
+#include "image.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <deque>
+#include <sstream>
+#include <algorithm>
+#include <unistd.h>
+#include <poll.h>
+#include <uv.h>
+
+
+namespace farm {
+
+
+std::vector<Job> make_jobs(Options const& options) {
+    std::vector<Job> jobs;
+    if (options.poster.x > 0) {
+        int t = options.tile;
+        for (int y = 0; y < (options.poster.y + t - 1) / t; ++y) {
+            for (int x = 0; x < (options.poster.x + t - 1) / t; ++x) jobs.push_back({ Job::Tile, x, y });
+        }
+    }
+    else {
+        for (int n = options.first; n <= options.last; ++n) jobs.push_back({ Job::Frame, n, 0 });
+    }
+    return jobs;
+}
+
+
+std::string frame_path(const char* pattern, int frame) {
+    char path[4096];
+    snprintf(path, sizeof(path), pattern, frame);
+    return path;
+}
+
+
+bool parse_job(std::string const& line, Job& job) {
+    std::istringstream ss(line);
+    std::string kind;
+    ss >> kind;
+    if (kind == "tile") {
+        job.kind = Job::Tile;
+        return bool(ss >> job.x >> job.y);
+    }
+    if (kind == "frame") {
+        job.kind = Job::Frame;
+        job.y    = 0;
+        return bool(ss >> job.x);
+    }
+    return false;
+}
+
+
+namespace {
+
+
+// the reply pipe may be non-blocking, so wait for it to drain
+bool write_all(int fd, void const* data, size_t size) {
+    char const* p = static_cast<char const*>(data);
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            pollfd pfd = { fd, POLLOUT, 0 };
+            poll(&pfd, 1, -1);
+            continue;
+        }
+        p    += n;
+        size -= n;
+    }
+    return true;
+}
+
+
+} // namespace
+
+
+bool send_reply(Job const& job, void const* data, int size) {
+    Reply r = { job, size };
+    return write_all(REPLY_FD, &r, sizeof(r)) && write_all(REPLY_FD, data, size);
+}
+
+
+Stitcher::~Stitcher() {
+    delete m_writer;
+}
+
+
+bool Stitcher::init(Options const& options) {
+    m_output  = options.output;
+    m_width   = options.poster.x;
+    m_height  = options.poster.y;
+    m_tile    = options.tile;
+    m_columns = (m_width + m_tile - 1) / m_tile;
+    m_writer  = image::Writer::create(m_output, m_width, m_height);
+    if (!m_writer) {
+        printf("cannot open %s\n", m_output);
+        return false;
+    }
+    return true;
+}
+
+
+bool Stitcher::add(Job const& job, float const* tile) {
+    Strip& s = m_strips[job.y];
+    s.data.resize(m_width * m_tile * 4);
+    int x = job.x * m_tile;
+    int w = std::min(m_tile, m_width - x);
+    for (int y = 0; y < m_tile; ++y) {
+        float const* src = tile + y * m_tile * 4;
+        std::copy(src, src + w * 4, &s.data[(y * m_width + x) * 4]);
+    }
+    ++s.tiles;
+
+    for (auto it = m_strips.begin(); it != m_strips.end() && it->first == m_next; it = m_strips.erase(it)) {
+        if (it->second.tiles < m_columns) break;
+        int rows = std::min(m_tile, m_height - m_rows_written);
+        if (!m_writer->write_rows(it->second.data.data(), rows)) {
+            printf("cannot write %s\n", m_output);
+            return false;
+        }
+        m_rows_written += rows;
+        ++m_next;
+    }
+    return true;
+}
+
+
+namespace {
+
+
+enum { JOBS_IN_FLIGHT = 2 }; // per worker, so it never waits for the next job
+
+
+class Farm;
+
+
+struct Worker {
+    Farm*           farm;
+    uv_process_t    process;
+    uv_pipe_t       jobs;    // the worker's stdin
+    uv_pipe_t       replies; // the worker's REPLY_FD
+    std::deque<Job> pending; // sent but not answered yet
+    std::string     buffer;  // received reply bytes
+    bool            alive = false;
+};
+
+
+struct WriteRequest {
+    uv_write_t req;
+    char       line[64];
+};
+
+
+void close(uv_handle_t* h) {
+    if (!uv_is_closing(h)) uv_close(h, nullptr);
+}
+
+
+class Farm {
+public:
+    int run(Options const& options, int argc, char** argv);
+
+private:
+    bool spawn(Worker& w, char** args);
+    void send(Worker& w, Job const& job);
+    void dispatch();
+    void handle_replies(Worker& w);
+    void worker_exited(Worker& w, int64_t status, int signal);
+    void fail();
+
+    static void alloc_callback(uv_handle_t*, size_t, uv_buf_t* buf) {
+        static char data[1 << 16];
+        buf->base = data;
+        buf->len  = sizeof(data);
+    }
+
+    static void read_callback(uv_stream_t* stream, ssize_t n, uv_buf_t const* buf) {
+        Worker& w = *(Worker*) stream->data;
+        if (n < 0) {
+            close((uv_handle_t*) stream);
+            return;
+        }
+        w.buffer.append(buf->base, n);
+        w.farm->handle_replies(w);
+    }
+
+    static void write_callback(uv_write_t* req, int) {
+        delete (WriteRequest*) req;
+    }
+
+    static void exit_callback(uv_process_t* process, int64_t status, int signal) {
+        Worker& w = *(Worker*) process->data;
+        w.farm->worker_exited(w, status, signal);
+    }
+
+    Options             m_options;
+    uv_loop_t*          m_loop;
+    std::vector<Worker> m_workers;
+    std::deque<Job>     m_jobs;       // not handed out yet
+    int                 m_total = 0;
+    int                 m_done  = 0;
+    bool                m_failed = false;
+    Stitcher            m_stitcher;
+};
+
+
+int Farm::run(Options const& options, int argc, char** argv) {
+    m_options = options;
+    for (Job const& job : make_jobs(options)) m_jobs.push_back(job);
+    m_total = m_jobs.size();
+    if (options.poster.x > 0 && !m_stitcher.init(options)) return 1;
+
+    // workers run this executable with our arguments minus --workers
+    char   exe[4096];
+    size_t exe_size = sizeof(exe);
+    if (uv_exepath(exe, &exe_size) != 0) {
+        printf("farm: cannot find the executable\n");
+        return 1;
+    }
+    static char worker_flag[] = "--worker";
+    std::vector<char*> args = { exe };
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--workers") == 0) ++i;
+        else args.emplace_back(argv[i]);
+    }
+    args.emplace_back(worker_flag);
+    args.emplace_back(nullptr);
+
+    m_loop    = uv_default_loop();
+    m_workers = std::vector<Worker>(options.workers);
+    int started = 0;
+    for (Worker& w : m_workers) started += spawn(w, args.data());
+    if (started == 0) fail();
+    printf("farm: %d workers, %d jobs\n", started, m_total);
+
+    dispatch();
+    uv_run(m_loop, UV_RUN_DEFAULT);
+    uv_loop_close(m_loop);
+
+    if (m_failed || m_done < m_total) {
+        printf("farm: %d of %d jobs done\n", m_done, m_total);
+        return 1;
+    }
+    return 0;
+}
+
+
+bool Farm::spawn(Worker& w, char** args) {
+    w.farm = this;
+    uv_pipe_init(m_loop, &w.jobs, 0);
+    uv_pipe_init(m_loop, &w.replies, 0);
+    w.process.data = w.jobs.data = w.replies.data = &w;
+
+    uv_stdio_container_t stdio[4];
+    stdio[0].flags       = (uv_stdio_flags) (UV_CREATE_PIPE | UV_READABLE_PIPE);
+    stdio[0].data.stream = (uv_stream_t*) &w.jobs;
+    stdio[1].flags       = UV_INHERIT_FD;
+    stdio[1].data.fd     = 1;
+    stdio[2].flags       = UV_INHERIT_FD;
+    stdio[2].data.fd     = 2;
+    stdio[3].flags       = (uv_stdio_flags) (UV_CREATE_PIPE | UV_WRITABLE_PIPE);
+    stdio[3].data.stream = (uv_stream_t*) &w.replies;
+
+    uv_process_options_t po = {};
+    po.file        = args[0];
+    po.args        = args;
+    po.stdio       = stdio;
+    po.stdio_count = 4;
+    po.exit_cb     = exit_callback;
+
+    int r = uv_spawn(m_loop, &w.process, &po);
+    if (r != 0) {
+        printf("farm: cannot start worker: %s\n", uv_strerror(r));
+        close((uv_handle_t*) &w.process);
+        close((uv_handle_t*) &w.jobs);
+        close((uv_handle_t*) &w.replies);
+        return false;
+    }
+    w.alive = true;
+    uv_read_start((uv_stream_t*) &w.replies, alloc_callback, read_callback);
+    return true;
+}
+
+
+void Farm::send(Worker& w, Job const& job) {
+    auto req = new WriteRequest;
+    int n = job.kind == Job::Tile
+          ? snprintf(req->line, sizeof(req->line), "tile %d %d\n", job.x, job.y)
+          : snprintf(req->line, sizeof(req->line), "frame %d\n", job.x);
+    uv_buf_t buf = uv_buf_init(req->line, n);
+    uv_write(&req->req, (uv_stream_t*) &w.jobs, &buf, 1, write_callback);
+    w.pending.push_back(job);
+}
+
+
+void Farm::dispatch() {
+    // jobs go out in output order, so stitched rows complete early
+    bool busy = false;
+    for (Worker& w : m_workers) {
+        while (w.alive && !m_jobs.empty() && w.pending.size() < JOBS_IN_FLIGHT) {
+            send(w, m_jobs.front());
+            m_jobs.pop_front();
+        }
+        busy |= !w.pending.empty();
+    }
+    if (busy || !m_jobs.empty()) return;
+
+    // all done. closing the job pipes lets the workers exit
+    for (Worker& w : m_workers) {
+        if (w.alive) close((uv_handle_t*) &w.jobs);
+    }
+}
+
+
+void Farm::handle_replies(Worker& w) {
+    while (w.buffer.size() >= sizeof(Reply)) {
+        Reply r;
+        memcpy(&r, w.buffer.data(), sizeof(r));
+        if (w.buffer.size() < sizeof(Reply) + r.size) break;
+
+        auto it = std::find_if(w.pending.begin(), w.pending.end(), [&r](Job const& j) {
+            return j.kind == r.job.kind && j.x == r.job.x && j.y == r.job.y;
+        });
+        int tile_size = m_options.tile * m_options.tile * 4 * sizeof(float);
+        if (it == w.pending.end() || (r.job.kind == Job::Tile && r.size != tile_size)) {
+            printf("farm: bad reply from worker %d\n", w.process.pid);
+            uv_process_kill(&w.process, SIGTERM);
+            close((uv_handle_t*) &w.replies);
+            return;
+        }
+        w.pending.erase(it);
+
+        if (r.job.kind == Job::Tile) {
+            float const* data = reinterpret_cast<float const*>(w.buffer.data() + sizeof(Reply));
+            if (!m_stitcher.add(r.job, data)) {
+                fail();
+                return;
+            }
+        }
+        w.buffer.erase(0, sizeof(Reply) + r.size);
+        ++m_done;
+        if (r.job.kind == Job::Tile) {
+            printf("farm: %d/%d rows\n", m_stitcher.rows_written(), m_options.poster.y);
+        }
+        else printf("farm: %d/%d frames\n", m_done, m_total);
+    }
+    dispatch();
+}
+
+
+void Farm::worker_exited(Worker& w, int64_t status, int signal) {
+    w.alive = false;
+    close((uv_handle_t*) &w.process);
+    close((uv_handle_t*) &w.jobs);
+    close((uv_handle_t*) &w.replies);
+
+    // hand unfinished jobs to the others
+    if (!w.pending.empty() && !m_failed) {
+        printf("farm: worker %d died (status %d, signal %d), rescheduling %d jobs\n",
+               w.process.pid, int(status), signal, int(w.pending.size()));
+        m_jobs.insert(m_jobs.begin(), w.pending.begin(), w.pending.end());
+    }
+    w.pending.clear();
+    bool any = std::any_of(m_workers.begin(), m_workers.end(), [](Worker const& w) { return w.alive; });
+    if (!any && !m_jobs.empty()) {
+        printf("farm: no workers left\n");
+        m_jobs.clear();
+    }
+    dispatch();
+}
+
+
+void Farm::fail() {
+    m_failed = true;
+    m_jobs.clear();
+    for (Worker& w : m_workers) {
+        if (w.alive) uv_process_kill(&w.process, SIGTERM);
+    }
+}
+
+
+} // namespace
+
+
+int run(Options const& options, int argc, char** argv) {
+    Farm farm;
+    return farm.run(options, argc, argv);
+}
+
+
+} // namespace
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+
+struct Options;
+
+namespace image { struct Writer; }
+
+
+namespace farm {
+
+    struct Job {
+        enum Kind : int32_t { Tile, Frame };
+        Kind    kind;
+        int32_t x; // tile column or frame number
+        int32_t y; // tile row
+    };
+
+    // every job of the render the options describe, in output order
+    std::vector<Job> make_jobs(Options const& options);
+
+    // file name of an animation frame, from the printf pattern given with -o
+    std::string frame_path(const char* pattern, int frame);
+
+
+    // the coordinator writes one job per line to a worker's stdin,
+    // "tile <column> <row>" or "frame <n>". the worker answers every job
+    // on REPLY_FD with a Reply, followed by the tile as top-down RGBA floats
+    // for tile jobs. frames are written to disk by the worker itself.
+    enum { REPLY_FD = 3 };
+
+    struct Reply {
+        Job     job;
+        int32_t size; // bytes of pixel data that follow
+    };
+
+    bool parse_job(std::string const& line, Job& job);
+    bool send_reply(Job const& job, void const* data, int size);
+
+
+    // collects poster tiles, which may come in any order, into rows of tiles
+    // and writes each row to the image once all rows above it are written
+    class Stitcher {
+    public:
+        ~Stitcher();
+        bool init(Options const& options);
+        // tile x tile RGBA floats, top to bottom
+        bool add(Job const& job, float const* tile);
+        int  rows_written() const { return m_rows_written; }
+
+    private:
+        struct Strip {
+            std::vector<float> data;
+            int                tiles = 0;
+        };
+        image::Writer*       m_writer       = nullptr;
+        const char*          m_output       = nullptr;
+        int                  m_width        = 0;
+        int                  m_height       = 0;
+        int                  m_tile         = 0;
+        int                  m_columns      = 0;
+        int                  m_next         = 0; // next row of tiles to write
+        int                  m_rows_written = 0;
+        std::map<int, Strip> m_strips;
+    };
+
+
+    // spread the render over options.workers processes running this program
+    // with the same arguments plus --worker, and gather the results
+    int run(Options const& options, int argc, char** argv);
+}
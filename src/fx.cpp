@@ -35,7 +35,10 @@ void exit(int res) {
 }
 
 
-int run(App& app) {
+int run(App& app, Config const& config) {
+
+    s_screen_width  = config.width;
+    s_screen_height = config.height;
 
     SDL_Init(SDL_INIT_VIDEO);
     IMG_Init(IMG_INIT_PNG);
@@ -49,7 +52,7 @@ int run(App& app) {
             SDL_WINDOWPOS_UNDEFINED,
             SDL_WINDOWPOS_UNDEFINED,
             s_screen_width, s_screen_height,
-            SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+            SDL_WINDOW_OPENGL | (config.headless ? SDL_WINDOW_HIDDEN : SDL_WINDOW_RESIZABLE));
 
     s_gl_context = SDL_GL_CreateContext(s_window);
     if (!s_gl_context) {
@@ -64,7 +67,7 @@ int run(App& app) {
         return 1;
     }
 
-    SDL_GL_SetSwapInterval(1); // v-sync
+    SDL_GL_SetSwapInterval(config.headless ? 0 : 1); // v-sync
 
 
     app.init();
@@ -13,7 +13,13 @@ namespace fx {
         virtual void process_event(SDL_Event const& e) {}
     };
 
-    int run(App& App);
+    struct Config {
+        int  width    = 800;
+        int  height   = 600;
+        bool headless = false; // hidden window, no v-sync
+    };
+
+    int run(App& App, Config const& config = {});
     void exit(int result = 0);
 
     struct Input {
@@ -1,6 +1,7 @@
 #include "gfx.hpp"
 #include "fx.hpp"
 #include <array>
+#include <algorithm>
 #include <variant>
 #include <stdexcept>
 #include <SDL2/SDL.h>
@@ -54,7 +55,33 @@ constexpr uint32_t map_to_gl(CullFace cf) {
     return lut[static_cast<int>(cf)];
 }
 constexpr uint32_t map_to_gl(TextureFormat tf) {
-    constexpr uint32_t lut[] = { GL_RED, GL_RGB, GL_RGBA, GL_DEPTH_COMPONENT, GL_STENCIL_INDEX, GL_DEPTH_STENCIL, GL_RGBA32F };
+    constexpr uint32_t lut[] = {
+        GL_RED, GL_RGB, GL_RGBA, GL_DEPTH_COMPONENT, GL_STENCIL_INDEX, GL_DEPTH_STENCIL,
+        GL_RGBA32F, GL_RGBA16F, GL_R32F, GL_R16F,
+    };
+    return lut[static_cast<int>(tf)];
+}
+// for immutable storage, which wants sized formats
+constexpr uint32_t map_to_gl_sized(TextureFormat tf) {
+    constexpr uint32_t lut[] = {
+        GL_R8, GL_RGB8, GL_RGBA8, GL_DEPTH_COMPONENT16, GL_STENCIL_INDEX8, GL_DEPTH24_STENCIL8,
+        GL_RGBA32F, GL_RGBA16F, GL_R32F, GL_R16F,
+    };
+    return lut[static_cast<int>(tf)];
+}
+// format and type of pixel data handed in for a texture
+constexpr uint32_t map_to_gl_pixel_format(TextureFormat tf) {
+    constexpr uint32_t lut[] = {
+        GL_RED, GL_RGB, GL_RGBA, GL_DEPTH_COMPONENT, GL_STENCIL_INDEX, GL_DEPTH_STENCIL,
+        GL_RGBA, GL_RGBA, GL_RED, GL_RED,
+    };
+    return lut[static_cast<int>(tf)];
+}
+constexpr uint32_t map_to_gl_pixel_type(TextureFormat tf) {
+    constexpr uint32_t lut[] = {
+        GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE, GL_UNSIGNED_INT, GL_UNSIGNED_BYTE,
+        GL_UNSIGNED_INT_24_8, GL_FLOAT, GL_FLOAT, GL_FLOAT, GL_FLOAT,
+    };
     return lut[static_cast<int>(tf)];
 }
 constexpr uint32_t map_to_gl(WrapMode wm) {
@@ -96,11 +123,17 @@ private:
 } gl;
 
 
+// GL 4.5 direct state access, picked at init. objects are then created
+// with glCreate* and edited by name, without touching the bindings
+bool s_dsa = false;
+
+
 template<class T, uint32_t target>
 struct GpuBuffer : T {
 
     GpuBuffer(BufferHint hint) : m_hint(hint) {
-        glGenBuffers(1, &m_handle);
+        if (s_dsa) glCreateBuffers(1, &m_handle);
+        else glGenBuffers(1, &m_handle);
     }
 
     ~GpuBuffer() override {
@@ -109,6 +142,10 @@ struct GpuBuffer : T {
 
     void init_data(void const* data, int size) override {
         m_size = size;
+        if (s_dsa) {
+            glNamedBufferData(m_handle, m_size, data, map_to_gl(m_hint));
+            return;
+        }
         gl.bind_vertex_array(0);
         bind();
         glBufferData(target, m_size, data, map_to_gl(m_hint));
@@ -128,9 +165,90 @@ using VertexBufferImpl = GpuBuffer<VertexBuffer, GL_ARRAY_BUFFER>;
 using IndexBufferImpl = GpuBuffer<IndexBuffer, GL_ELEMENT_ARRAY_BUFFER>;
 
 
+struct StreamBufferImpl : StreamBuffer {
+    StreamBufferImpl(int region_size, int regions)
+        : m_buffer(BufferHint::StreamDraw)
+        , m_region_size(region_size)
+        , m_fences(regions, nullptr)
+    {
+        int        size  = region_size * regions;
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        if (s_dsa) {
+            glNamedBufferStorage(m_buffer.m_handle, size, nullptr, flags);
+            m_memory = static_cast<uint8_t*>(glMapNamedBufferRange(m_buffer.m_handle, 0, size, flags));
+            m_buffer.m_size = size;
+            return;
+        }
+        gl.bind_vertex_array(0);
+        m_buffer.bind();
+        if (GLEW_ARB_buffer_storage) {
+            glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+            m_memory = static_cast<uint8_t*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+        }
+        else {
+            glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+            m_staging.resize(region_size);
+        }
+        m_buffer.m_size = size;
+    }
+
+    ~StreamBufferImpl() override {
+        for (GLsync f : m_fences) if (f) glDeleteSync(f);
+        if (m_memory && s_dsa) glUnmapNamedBuffer(m_buffer.m_handle);
+        else if (m_memory) {
+            m_buffer.bind();
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+    }
+
+    VertexBuffer* get_vertex_buffer() override { return &m_buffer; }
+    int get_region_size() const override { return m_region_size; }
+
+    void* map(int size) override {
+        if (size > m_region_size) return nullptr;
+        m_region = (m_region + 1) % m_fences.size();
+        GLsync& f = m_fences[m_region];
+        if (f) {
+            glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(f);
+            f = nullptr;
+        }
+        m_mapped = size;
+        if (m_memory) return m_memory + m_region * m_region_size;
+        return m_staging.data();
+    }
+
+    int unmap() override {
+        int offset = m_region * m_region_size;
+        if (!m_memory && m_mapped > 0) {
+            gl.bind_vertex_array(0);
+            m_buffer.bind();
+            glBufferSubData(GL_ARRAY_BUFFER, offset, m_mapped, m_staging.data());
+        }
+        m_mapped = 0;
+        return offset;
+    }
+
+    void fence() override {
+        GLsync& f = m_fences[m_region];
+        if (f) glDeleteSync(f);
+        f = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    VertexBufferImpl     m_buffer;
+    int                  m_region_size;
+    std::vector<GLsync>  m_fences;          // per region, set while draws may read it
+    int                  m_region = 0;      // the last mapped
+    int                  m_mapped = 0;
+    uint8_t*             m_memory = nullptr; // the whole ring, if persistently mapped
+    std::vector<uint8_t> m_staging;
+};
+
+
 struct VertexArrayImpl : VertexArray {
     VertexArrayImpl() {
-        glGenVertexArrays(1, &m_handle);
+        if (s_dsa) glCreateVertexArrays(1, &m_handle);
+        else glGenVertexArrays(1, &m_handle);
     }
     ~VertexArrayImpl() override {
         glDeleteVertexArrays(1, &m_handle);
@@ -138,41 +256,65 @@ struct VertexArrayImpl : VertexArray {
 
     void set_first(int i) override { m_first = i; }
     void set_count(int i) override { m_count = i; }
+    void set_instance_count(int n) override { m_instance_count = n; }
     void set_primitive_type(PrimitiveType t) override { m_primitive_type = t; }
 
     void set_attribute(int i, VertexBuffer* vb, ComponentType component_type,
                        int component_count, bool normalized, int offset, int stride) override
     {
+        if (s_dsa) {
+            // each attribute gets the binding point of the same index
+            glEnableVertexArrayAttrib(m_handle, i);
+            glVertexArrayAttribFormat(m_handle, i, component_count, map_to_gl(component_type), normalized, 0);
+            glVertexArrayVertexBuffer(m_handle, i, static_cast<VertexBufferImpl*>(vb)->m_handle, offset, stride);
+            glVertexArrayAttribBinding(m_handle, i, i);
+            return;
+        }
         gl.bind_vertex_array(m_handle);
         static_cast<VertexBufferImpl*>(vb)->bind();
         glEnableVertexAttribArray(i);
         glVertexAttribPointer(i, component_count, map_to_gl(component_type),
                               normalized, stride, reinterpret_cast<void const*>(offset));
     }
-    void set_attribute(int i, float f) override {
+    void set_divisor(int i, int divisor) override {
+        if (s_dsa) {
+            glVertexArrayBindingDivisor(m_handle, i, divisor);
+            return;
+        }
         gl.bind_vertex_array(m_handle);
-        glDisableVertexAttribArray(i);
+        glVertexAttribDivisor(i, divisor);
+    }
+    void disable_attribute(int i) {
+        if (s_dsa) glDisableVertexArrayAttrib(m_handle, i);
+        else {
+            gl.bind_vertex_array(m_handle);
+            glDisableVertexAttribArray(i);
+        }
+    }
+    void set_attribute(int i, float f) override {
+        disable_attribute(i);
         glVertexAttrib1f(i, f);
     }
     void set_attribute(int i, const glm::vec2& v) override {
-        gl.bind_vertex_array(m_handle);
-        glDisableVertexAttribArray(i);
+        disable_attribute(i);
         glVertexAttrib2fv(i, &v.x);
     }
     void set_attribute(int i, const glm::vec3& v) override {
-        gl.bind_vertex_array(m_handle);
-        glDisableVertexAttribArray(i);
+        disable_attribute(i);
         glVertexAttrib3fv(i, &v.x);
     }
     void set_attribute(int i, const glm::vec4& v) override {
-        gl.bind_vertex_array(m_handle);
-        glDisableVertexAttribArray(i);
+        disable_attribute(i);
         glVertexAttrib4fv(i, &v.x);
     }
 
     void set_index_buffer(IndexBuffer* ib) override {
         if (ib) {
             m_indexed = true;
+            if (s_dsa) {
+                glVertexArrayElementBuffer(m_handle, static_cast<IndexBufferImpl*>(ib)->m_handle);
+                return;
+            }
             gl.bind_vertex_array(m_handle);
             static_cast<IndexBufferImpl*>(ib)->bind();
         }
@@ -183,6 +325,7 @@ struct VertexArrayImpl : VertexArray {
 
     int           m_first = 0;
     int           m_count = 0;
+    int           m_instance_count = 0;
     bool          m_indexed = false;
     PrimitiveType m_primitive_type = PrimitiveType::Triangles;
     uint32_t      m_handle;
@@ -191,7 +334,8 @@ struct VertexArrayImpl : VertexArray {
 
 struct Texture2DImpl : Texture2D {
     Texture2DImpl() {
-        glGenTextures(1, &m_handle);
+        if (s_dsa) glCreateTextures(GL_TEXTURE_2D, 1, &m_handle);
+        else glGenTextures(1, &m_handle);
     }
 
     ~Texture2DImpl() override {
@@ -201,6 +345,37 @@ struct Texture2DImpl : Texture2D {
     int get_width() const override { return m_width; }
     int get_height() const override { return m_height; }
 
+    void get_data(TextureFormat format, void* data) const override {
+        bool f = format == TextureFormat::RGBA32F;
+        if (s_dsa) {
+            glGetTextureImage(m_handle, 0, GL_RGBA, f ? GL_FLOAT : GL_UNSIGNED_BYTE,
+                              m_width * m_height * (f ? 16 : 4), data);
+            return;
+        }
+        gl.bind_texture(0, GL_TEXTURE_2D, m_handle);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, f ? GL_FLOAT : GL_UNSIGNED_BYTE, data);
+    }
+
+    void generate_mipmaps() override {
+        if (s_dsa) {
+            glGenerateTextureMipmap(m_handle);
+            return;
+        }
+        gl.bind_texture(0, GL_TEXTURE_2D, m_handle);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    void set_rows(int y, int rows, void const* data) override {
+        if (s_dsa) {
+            glTextureSubImage2D(m_handle, 0, 0, y, m_width, rows,
+                                map_to_gl_pixel_format(m_format), map_to_gl_pixel_type(m_format), data);
+            return;
+        }
+        gl.bind_texture(0, GL_TEXTURE_2D, m_handle);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, m_width, rows,
+                        map_to_gl_pixel_format(m_format), map_to_gl_pixel_type(m_format), data);
+    }
+
     // TODO: sampler stuff
 //    void set_wrap(WrapMode horiz, WrapMode vert);
 //    void set_filter(FilterMode min, FilterMode mag);
@@ -224,6 +399,9 @@ struct Texture2DImpl : Texture2D {
         //printf("error %d\n", glGetError());
         m_width  = w;
         m_height = h;
+        m_format = format;
+
+        if (s_dsa) return init_dsa(format, data, filter, wrap);
 
         gl.bind_texture(0, GL_TEXTURE_2D, m_handle);
 
@@ -263,9 +441,91 @@ struct Texture2DImpl : Texture2D {
         return true;
     }
 
+    // immutable storage, the data goes in as a sub image
+    bool init_dsa(TextureFormat format, void const* data, FilterMode filter, WrapMode wrap) {
+        int levels = 1;
+        if (filter == FilterMode::Trilinear) {
+            while ((std::max(m_width, m_height) >> levels) > 0) ++levels;
+        }
+        glTextureParameteri(m_handle, GL_TEXTURE_MAG_FILTER, filter == FilterMode::Nearest ? GL_NEAREST : GL_LINEAR);
+        glTextureParameteri(m_handle, GL_TEXTURE_MIN_FILTER,
+                            filter == FilterMode::Nearest   ? GL_NEAREST :
+                            filter == FilterMode::Trilinear ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        if (format == TextureFormat::Depth) {
+            float c[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            glTextureParameterfv(m_handle, GL_TEXTURE_BORDER_COLOR, c);
+            glTextureParameteri(m_handle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+            glTextureParameteri(m_handle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        }
+        else {
+            glTextureParameteri(m_handle, GL_TEXTURE_WRAP_S, map_to_gl(wrap));
+            glTextureParameteri(m_handle, GL_TEXTURE_WRAP_T, map_to_gl(wrap));
+        }
+        glTextureStorage2D(m_handle, levels, map_to_gl_sized(format), m_width, m_height);
+        if (data) {
+            glTextureSubImage2D(m_handle, 0, 0, 0, m_width, m_height,
+                                map_to_gl_pixel_format(format), map_to_gl_pixel_type(format), data);
+        }
+        if (levels > 1) glGenerateTextureMipmap(m_handle);
+        return true;
+    }
+
 
     int           m_width;
     int           m_height;
+    TextureFormat m_format;
+    uint32_t      m_handle;
+};
+
+
+struct Texture3DImpl : Texture3D {
+    Texture3DImpl(TextureFormat format, int w, int h, int d, FilterMode filter)
+        : m_width(w), m_height(h), m_depth(d), m_format(format)
+    {
+        int levels = 1;
+        if (filter == FilterMode::Trilinear) {
+            while ((std::max({ w, h, d }) >> levels) > 0) ++levels;
+        }
+        uint32_t mag = filter == FilterMode::Nearest ? GL_NEAREST : GL_LINEAR;
+        uint32_t min = filter == FilterMode::Nearest   ? GL_NEAREST :
+                       filter == FilterMode::Trilinear ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+        if (s_dsa) {
+            glCreateTextures(GL_TEXTURE_3D, 1, &m_handle);
+            glTextureParameteri(m_handle, GL_TEXTURE_MAG_FILTER, mag);
+            glTextureParameteri(m_handle, GL_TEXTURE_MIN_FILTER, min);
+            glTextureParameteri(m_handle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTextureParameteri(m_handle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTextureParameteri(m_handle, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+            glTextureStorage3D(m_handle, levels, map_to_gl_sized(format), w, h, d);
+            return;
+        }
+        glGenTextures(1, &m_handle);
+        gl.bind_texture(0, GL_TEXTURE_3D, m_handle);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, mag);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, min);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        for (int l = 0; l < levels; ++l) {
+            glTexImage3D(GL_TEXTURE_3D, l, map_to_gl(format),
+                         std::max(1, w >> l), std::max(1, h >> l), std::max(1, d >> l), 0,
+                         map_to_gl_pixel_format(format), map_to_gl_pixel_type(format), nullptr);
+        }
+        if (levels == 1) glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+    }
+
+    ~Texture3DImpl() override {
+        glDeleteTextures(1, &m_handle);
+    }
+
+    int get_width() const override { return m_width; }
+    int get_height() const override { return m_height; }
+    int get_depth() const override { return m_depth; }
+
+    int           m_width;
+    int           m_height;
+    int           m_depth;
+    TextureFormat m_format;
     uint32_t      m_handle;
 };
 
@@ -310,7 +570,19 @@ struct ShaderImpl : Shader {
         }
 
         glLinkProgram(m_program);
+        introspect();
+    }
 
+    void init_compute(const char* cs) {
+        m_program = glCreateProgram();
+        GLint c = compile_shader(GL_COMPUTE_SHADER, cs);
+        glAttachShader(m_program, c);
+        glDeleteShader(c);
+        glLinkProgram(m_program);
+        introspect();
+    }
+
+    void introspect() {
         // attributes
         int count;
         glGetProgramiv(m_program, GL_ACTIVE_ATTRIBUTES, &count);
@@ -341,6 +613,8 @@ struct ShaderImpl : Shader {
             case GL_FLOAT_MAT3: u.extent = Uniform::Extent<glm::mat3>(); break;
             case GL_FLOAT_MAT4: u.extent = Uniform::Extent<glm::mat4>(); break;
             case GL_SAMPLER_2D: u.extent = Uniform::ExtentTexture2D(); break;
+            case GL_SAMPLER_3D: u.extent = Uniform::ExtentTexture3D(); break;
+            case GL_IMAGE_2D:   u.extent = Uniform::ExtentImage2D{ true, 0, 0, m_image_count++ }; break;
             default:
                 fprintf(stderr, "Error: uniform '%s' has unknown type (%d)\n", name, type);
                 assert(false);
@@ -368,10 +642,23 @@ struct ShaderImpl : Shader {
             std::visit([this](auto& e) {
                 using T = std::decay_t<decltype(e)>;
                 if constexpr (std::is_same_v<T, ExtentTexture2D>) {
+                    e.dirty = false;
                     int unit = location;
                     gl.bind_texture(unit, GL_TEXTURE_2D, e.handle);
                     glUniform1i(location, unit);
                 }
+                else if constexpr (std::is_same_v<T, ExtentTexture3D>) {
+                    e.dirty = false;
+                    int unit = location;
+                    gl.bind_texture(unit, GL_TEXTURE_3D, e.handle);
+                    glUniform1i(location, unit);
+                }
+                else if constexpr (std::is_same_v<T, ExtentImage2D>) {
+                    // image units are shared by all programs, like texture units
+                    e.dirty = false;
+                    glBindImageTexture(e.unit, e.handle, 0, GL_FALSE, 0, GL_READ_WRITE, e.format);
+                    glUniform1i(location, e.unit);
+                }
                 else {
                     if (!e.dirty) return;
                     e.dirty = false;
@@ -387,14 +674,45 @@ struct ShaderImpl : Shader {
             T            value;
         };
         struct ExtentTexture2D {
-            uint32_t handle;
+            mutable bool dirty  = true;
+            uint32_t     handle = 0;
+        };
+        struct ExtentTexture3D {
+            mutable bool dirty  = true;
+            uint32_t     handle = 0;
+        };
+        struct ExtentImage2D {
+            mutable bool dirty;
+            uint32_t     handle;
+            uint32_t     format; // sized, as the texture was created
+            int          unit;
         };
 
         template<class T>
         void set(const T& value) {
             if constexpr (std::is_same<T, Texture2D*>::value) {
+                auto ti = static_cast<Texture2DImpl*>(value);
+                if (auto i = std::get_if<ExtentImage2D>(&extent)) {
+                    if (i->handle != ti->m_handle) {
+                        i->handle = ti->m_handle;
+                        i->format = map_to_gl_sized(ti->m_format);
+                        i->dirty  = true;
+                    }
+                    return;
+                }
                 ExtentTexture2D& e = std::get<ExtentTexture2D>(extent);
-                e.handle = static_cast<Texture2DImpl*>(value)->m_handle;
+                if (e.handle != ti->m_handle) {
+                    e.handle = ti->m_handle;
+                    e.dirty = true;
+                }
+            }
+            else if constexpr (std::is_same<T, Texture3D*>::value) {
+                auto ti = static_cast<Texture3DImpl*>(value);
+                ExtentTexture3D& e = std::get<ExtentTexture3D>(extent);
+                if (e.handle != ti->m_handle) {
+                    e.handle = ti->m_handle;
+                    e.dirty = true;
+                }
             }
             else {
                 Extent<T>& e = std::get<Extent<T>>(extent);
@@ -405,6 +723,10 @@ struct ShaderImpl : Shader {
             }
         }
 
+        bool is_dirty() const {
+            return std::visit([](auto& e) { return e.dirty; }, extent);
+        }
+
         const std::string name;
         const uint32_t    type;
         const int         location;
@@ -416,13 +738,22 @@ struct ShaderImpl : Shader {
             Extent<glm::vec4>,
             Extent<glm::mat3>,
             Extent<glm::mat4>,
-            ExtentTexture2D
+            ExtentTexture2D,
+            ExtentTexture3D,
+            ExtentImage2D
         > extent;
     };
 
 
     bool has_uniform(std::string const& name) override { return find_uniform(name) != nullptr; }
+    bool has_dirty_uniforms() const override {
+        for (auto& u : m_uniforms) {
+            if (u.is_dirty()) return true;
+        }
+        return false;
+    }
     void set_uniform(std::string const& name, Texture2D* v) override { set(name, v); }
+    void set_uniform(std::string const& name, Texture3D* v) override { set(name, v); }
     void set_uniform(std::string const& name, int v) override { set(name, v); }
     void set_uniform(std::string const& name, float v) override { set(name, v); }
     void set_uniform(std::string const& name, glm::vec2 const& v) override { set(name, v); }
@@ -450,30 +781,185 @@ struct ShaderImpl : Shader {
     }
 
     uint32_t               m_program = 0;
+    int                    m_image_count = 0;
     std::vector<Attribute> m_attributes;
     std::vector<Uniform>   m_uniforms;
 };
 
 
 
+struct ReadbackImpl : Readback {
+    struct Slot {
+        uint32_t pbo;
+        GLsync   fence  = nullptr; // set while the copy is in flight
+        int      width  = 0;
+        int      height = 0;
+        int      size   = 0;       // allocated bytes
+    };
+
+    ReadbackImpl(int ring_size) : m_slots(ring_size) {
+        for (Slot& s : m_slots) glGenBuffers(1, &s.pbo);
+    }
+
+    ~ReadbackImpl() override {
+        if (m_mapped) unmap();
+        for (Slot& s : m_slots) {
+            if (s.fence) glDeleteSync(s.fence);
+            glDeleteBuffers(1, &s.pbo);
+        }
+    }
+
+    bool start(Texture2D* t, TextureFormat format) override {
+        if (full()) return false;
+        auto ti = static_cast<Texture2DImpl*>(t);
+        Slot& s = m_slots[(m_first + m_count) % m_slots.size()];
+        bool  f = format == TextureFormat::RGBA32F;
+        s.width  = ti->m_width;
+        s.height = ti->m_height;
+        int size = s.width * s.height * (f ? 16 : 4);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+        if (s.size != size) {
+            s.size = size;
+            glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        }
+        if (s_dsa) glGetTextureImage(ti->m_handle, 0, GL_RGBA, f ? GL_FLOAT : GL_UNSIGNED_BYTE, size, nullptr);
+        else {
+            gl.bind_texture(0, GL_TEXTURE_2D, ti->m_handle);
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, f ? GL_FLOAT : GL_UNSIGNED_BYTE, nullptr);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        ++m_count;
+        return true;
+    }
+
+    bool full() const override { return m_count == (int) m_slots.size(); }
+
+    void const* map(int& width, int& height, bool wait) override {
+        if (m_count == 0 || m_mapped) return nullptr;
+        Slot& s = m_slots[m_first];
+        GLenum r = glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? GL_TIMEOUT_IGNORED : 0);
+        if (r == GL_TIMEOUT_EXPIRED || r == GL_WAIT_FAILED) return nullptr;
+        glDeleteSync(s.fence);
+        s.fence = nullptr;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pbo);
+        void const* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, s.size, GL_MAP_READ_BIT);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        width    = s.width;
+        height   = s.height;
+        m_mapped = true;
+        return data;
+    }
+
+    void unmap() override {
+        if (!m_mapped) return;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_slots[m_first].pbo);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        m_mapped = false;
+        m_first  = (m_first + 1) % m_slots.size();
+        --m_count;
+    }
+
+    std::vector<Slot> m_slots;
+    int               m_first  = 0; // oldest copy in flight
+    int               m_count  = 0;
+    bool              m_mapped = false;
+};
+
+
+
+struct GpuTimerImpl : GpuTimer {
+    GpuTimerImpl(int ring_size) : m_queries(ring_size) {
+        glGenQueries(m_queries.size(), m_queries.data());
+    }
+
+    ~GpuTimerImpl() override {
+        glDeleteQueries(m_queries.size(), m_queries.data());
+    }
+
+    bool begin() override {
+        if (m_count == (int) m_queries.size()) return false;
+        glBeginQuery(GL_TIME_ELAPSED, m_queries[(m_first + m_count) % m_queries.size()]);
+        m_running = true;
+        return true;
+    }
+
+    void end() override {
+        if (!m_running) return;
+        glEndQuery(GL_TIME_ELAPSED);
+        m_running = false;
+        ++m_count;
+    }
+
+    bool poll(float& ms) override {
+        if (m_count == 0) return false;
+        GLint ready = 0;
+        glGetQueryObjectiv(m_queries[m_first], GL_QUERY_RESULT_AVAILABLE, &ready);
+        if (!ready) return false;
+        GLuint64 ns;
+        glGetQueryObjectui64v(m_queries[m_first], GL_QUERY_RESULT, &ns);
+        ms      = ns * 1e-6;
+        m_first = (m_first + 1) % m_queries.size();
+        --m_count;
+        return true;
+    }
+
+    std::vector<uint32_t> m_queries;
+    int                   m_first   = 0; // oldest query in flight
+    int                   m_count   = 0;
+    bool                  m_running = false;
+};
+
+
+
 struct FramebufferImpl : Framebuffer {
     FramebufferImpl() {
-        glGenFramebuffers(1, &m_handle);
+        if (s_dsa) glCreateFramebuffers(1, &m_handle);
+        else glGenFramebuffers(1, &m_handle);
     }
     ~FramebufferImpl() override {
         glDeleteFramebuffers(1, &m_handle);
     }
-    void attach_color(Texture2D* t) override {
-        auto ti = static_cast<Texture2DImpl*>(t);
-        if (ti) {
+    void attach_colors(Texture2D* const* ts, int count) override {
+        count = std::min<int>(count, MAX_COLORS);
+        if (count > 0 && ts[0]) {
+            auto ti  = static_cast<Texture2DImpl*>(ts[0]);
             m_width  = ti->m_width;
             m_height = ti->m_height;
         }
-        gl.bind_framebuffer(m_handle);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                               GL_TEXTURE_2D, ti ? ti->m_handle : 0, 0);
-        // TODO: is this correct?
-        //glDrawBuffer(t ? GL_COLOR_ATTACHMENT0 : GL_NONE);
+        if (!s_dsa) gl.bind_framebuffer(m_handle);
+        for (int i = 0; i < std::max(count, m_color_count); ++i) {
+            auto     ti     = i < count ? static_cast<Texture2DImpl*>(ts[i]) : nullptr;
+            uint32_t handle = ti ? ti->m_handle : 0;
+            if (s_dsa) glNamedFramebufferTexture(m_handle, GL_COLOR_ATTACHMENT0 + i, handle, 0);
+            else glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, handle, 0);
+        }
+        if (count != m_color_count && count > 0) {
+            uint32_t bufs[MAX_COLORS];
+            for (int i = 0; i < count; ++i) bufs[i] = GL_COLOR_ATTACHMENT0 + i;
+            if (s_dsa) glNamedFramebufferDrawBuffers(m_handle, count, bufs);
+            else glDrawBuffers(count, bufs);
+        }
+        m_color_count = std::max(count, 1);
+    }
+    void attach_layer(Texture3D* t, int z) override {
+        auto ti  = static_cast<Texture3DImpl*>(t);
+        m_width  = ti->m_width;
+        m_height = ti->m_height;
+        if (!s_dsa) gl.bind_framebuffer(m_handle);
+        for (int i = 1; i < m_color_count; ++i) {
+            if (s_dsa) glNamedFramebufferTexture(m_handle, GL_COLOR_ATTACHMENT0 + i, 0, 0);
+            else glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, 0, 0);
+        }
+        if (s_dsa) glNamedFramebufferTextureLayer(m_handle, GL_COLOR_ATTACHMENT0, ti->m_handle, 0, z);
+        else glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, ti->m_handle, 0, z);
+        if (m_color_count != 1) {
+            uint32_t buf = GL_COLOR_ATTACHMENT0;
+            if (s_dsa) glNamedFramebufferDrawBuffers(m_handle, 1, &buf);
+            else glDrawBuffers(1, &buf);
+            m_color_count = 1;
+        }
     }
     void attach_depth(Texture2D* t) override {
         auto ti = static_cast<Texture2DImpl*>(t);
@@ -481,11 +967,18 @@ struct FramebufferImpl : Framebuffer {
             m_width  = ti->m_width;
             m_height = ti->m_height;
         }
+        if (s_dsa) {
+            glNamedFramebufferTexture(m_handle, GL_DEPTH_ATTACHMENT, ti ? ti->m_handle : 0, 0);
+            return;
+        }
         gl.bind_framebuffer(m_handle);
         glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
                                GL_TEXTURE_2D, ti ? ti->m_handle : 0, 0);
     }
     bool is_complete() const override {
+        if (s_dsa) {
+            return glCheckNamedFramebufferStatus(m_handle, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        }
         gl.bind_framebuffer(m_handle);
         return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
     }
@@ -493,6 +986,7 @@ struct FramebufferImpl : Framebuffer {
     uint32_t m_handle;
     int      m_width;
     int      m_height;
+    int      m_color_count = 1; // draw buffers
 };
 
 
@@ -504,6 +998,10 @@ VertexBuffer* VertexBuffer::create(BufferHint hint) {
     return new VertexBufferImpl(hint);
 }
 
+StreamBuffer* StreamBuffer::create(int region_size, int regions) {
+    return new StreamBufferImpl(region_size, std::max(1, regions));
+}
+
 IndexBuffer* IndexBuffer::create(BufferHint hint) {
     return new IndexBufferImpl(hint);
 }
@@ -518,6 +1016,12 @@ Shader* Shader::create(const char* vs, const char* fs) {
     return s;
 }
 
+Shader* Shader::create_compute(const char* cs) {
+    auto s = new ShaderImpl;
+    s->init_compute(cs);
+    return s;
+}
+
 Texture2D* Texture2D::create(SDL_Surface* s, FilterMode filter, WrapMode wrap) {
     auto t = new Texture2DImpl;
     if (!t->init(s, filter, wrap)) return nullptr;
@@ -536,6 +1040,18 @@ Texture2D* Texture2D::create(TextureFormat format, int w, int h, void const* dat
     return t;
 }
 
+Texture3D* Texture3D::create(TextureFormat format, int w, int h, int d, FilterMode filter) {
+    return new Texture3DImpl(format, w, h, d, filter);
+}
+
+Readback* Readback::create(int ring_size) {
+    return new ReadbackImpl(std::max(1, ring_size));
+}
+
+GpuTimer* GpuTimer::create(int ring_size) {
+    return new GpuTimerImpl(std::max(1, ring_size));
+}
+
 Framebuffer* Framebuffer::create() {
     return new FramebufferImpl();
 }
@@ -647,6 +1163,10 @@ bool init() {
     s_render_state.depth_test_func = DepthTestFunc::Less;
     glEnable(GL_PROGRAM_POINT_SIZE);
 
+    // the DSA paths also allocate immutable buffer and texture storage
+    s_dsa = GLEW_VERSION_4_5 || (GLEW_ARB_direct_state_access && GLEW_ARB_buffer_storage &&
+                                 GLEW_ARB_texture_storage);
+
     return true;
 }
 
@@ -710,13 +1230,59 @@ void draw(const RenderState& rs, Shader* shader, VertexArray* va, Framebuffer* f
 
     gl.bind_framebuffer(fbi ? fbi->m_handle : 0);
 
-    if (vai->m_indexed) {
-        glDrawElements(map_to_gl(vai->m_primitive_type), vai->m_count, GL_UNSIGNED_INT,
+    uint32_t mode = map_to_gl(vai->m_primitive_type);
+    if (vai->m_instance_count > 0) {
+        if (vai->m_indexed) {
+            glDrawElementsInstanced(mode, vai->m_count, GL_UNSIGNED_INT,
+                                    reinterpret_cast<void const*>(vai->m_first), vai->m_instance_count);
+        }
+        else {
+            glDrawArraysInstanced(mode, vai->m_first, vai->m_count, vai->m_instance_count);
+        }
+    }
+    else if (vai->m_indexed) {
+        glDrawElements(mode, vai->m_count, GL_UNSIGNED_INT,
                        reinterpret_cast<void const*>(vai->m_first));
     }
     else {
-        glDrawArrays(map_to_gl(vai->m_primitive_type), vai->m_first, vai->m_count);
+        glDrawArrays(mode, vai->m_first, vai->m_count);
+    }
+}
+
+
+void finish() {
+    glFinish();
+}
+
+
+void update_uniforms(Shader* shader) {
+    if (s_shader != static_cast<ShaderImpl*>(shader)) {
+        s_shader = static_cast<ShaderImpl*>(shader);
+        glUseProgram(s_shader->m_program);
+    }
+    s_shader->update_uniforms();
+}
+
+
+bool has_compute() {
+    return GLEW_VERSION_4_3 || GLEW_ARB_compute_shader;
+}
+
+
+void dispatch(Shader* shader, int x, int y, int z) {
+    if (s_shader != static_cast<ShaderImpl*>(shader)) {
+        s_shader = static_cast<ShaderImpl*>(shader);
+        glUseProgram(s_shader->m_program);
     }
+    s_shader->update_uniforms();
+    glDispatchCompute(x, y, z);
+}
+
+
+void barrier() {
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT |
+                    GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT |
+                    GL_PIXEL_BUFFER_BARRIER_BIT);
 }
 
 
@@ -82,6 +82,27 @@ struct VertexBuffer {
 };
 
 
+// a vertex buffer for data that changes every frame, written straight
+// into mapped memory. the storage is a ring of regions and each region is
+// fenced after the draws that read it, so writing only waits if the GPU is
+// a whole ring behind. persistent coherent mapping where the driver has
+// ARB_buffer_storage, else a copy through glBufferSubData
+struct StreamBuffer {
+    static StreamBuffer* create(int region_size, int regions = 3);
+    virtual ~StreamBuffer() {}
+    // for VertexArray::set_attribute. its init_data must not be used
+    virtual VertexBuffer* get_vertex_buffer() = 0;
+    virtual int get_region_size() const = 0;
+    // memory for size bytes in the next region, nullptr if size is more
+    // than a region. valid until unmap()
+    virtual void* map(int size) = 0;
+    // the byte offset of the written data in the buffer
+    virtual int unmap() = 0;
+    // call after the draws that read the last mapped region
+    virtual void fence() = 0;
+};
+
+
 struct IndexBuffer {
     static IndexBuffer* create(BufferHint hint);
     virtual ~IndexBuffer() {}
@@ -103,9 +124,13 @@ struct VertexArray {
     virtual ~VertexArray() {}
     virtual void set_first(int i) = 0;
     virtual void set_count(int i) = 0;
+    // draw count vertices for each of n instances. 0 draws once, not instanced
+    virtual void set_instance_count(int n) = 0;
     virtual void set_primitive_type(PrimitiveType t) = 0;
     virtual void set_attribute(int i, VertexBuffer* vb, ComponentType component_type, int component_count,
                                bool normalized, int offset, int stride) = 0;
+    // advance attribute i once per that many instances instead of per vertex
+    virtual void set_divisor(int i, int divisor) = 0;
     virtual void set_attribute(int i, float f) = 0;
     virtual void set_attribute(int i, glm::vec2 const& v) = 0;
     virtual void set_attribute(int i, glm::vec3 const& v) = 0;
@@ -121,7 +146,7 @@ enum class WrapMode { Clamp, Repeat, MirrowedRepeat };
 
 enum class FilterMode { Nearest, Linear, Trilinear };
 
-enum class TextureFormat { Red, RGB, RGBA, Depth, Stencil, DepthStencil, RGBA32F };
+enum class TextureFormat { Red, RGB, RGBA, Depth, Stencil, DepthStencil, RGBA32F, RGBA16F, R32F, R16F };
 
 struct Texture2D {
     static Texture2D* create(SDL_Surface* s, FilterMode filter = FilterMode::Nearest, WrapMode wrap = WrapMode::Clamp);
@@ -133,6 +158,58 @@ struct Texture2D {
     virtual ~Texture2D() {}
     virtual int get_width() const = 0;
     virtual int get_height() const = 0;
+    // read back level 0 as RGBA bytes (RGBA) or RGBA floats (RGBA32F)
+    virtual void get_data(TextureFormat format, void* data) const = 0;
+    // rebuild the levels below 0 from level 0. needs FilterMode::Trilinear
+    virtual void generate_mipmaps() = 0;
+    // replace rows y to y + rows - 1 of level 0 with data laid out like at create()
+    virtual void set_rows(int y, int rows, void const* data) = 0;
+};
+
+
+// a volume, sampled as sampler3D and clamped at the edges. rendered to one
+// slice at a time through Framebuffer::attach_layer()
+struct Texture3D {
+    static Texture3D* create(TextureFormat format, int w, int h, int d, FilterMode filter = FilterMode::Linear);
+
+    virtual ~Texture3D() {}
+    virtual int get_width() const = 0;
+    virtual int get_height() const = 0;
+    virtual int get_depth() const = 0;
+};
+
+
+
+// asynchronous read back of texture content through a ring of pixel buffer
+// objects. start() queues a copy and returns at once, map() hands out the
+// oldest copy once the GPU is done with it, so the caller never stalls
+struct Readback {
+    static Readback* create(int ring_size = 3);
+    virtual ~Readback() {}
+    // copy level 0 as bottom-up RGBA bytes (RGBA) or RGBA floats (RGBA32F).
+    // false if all buffers are in flight
+    virtual bool start(Texture2D* t, TextureFormat format = TextureFormat::RGBA) = 0;
+    // the oldest copy if it is finished (or once it is, with wait), else nullptr.
+    // the data stays valid until unmap()
+    virtual void const* map(int& width, int& height, bool wait = false) = 0;
+    virtual void unmap() = 0;
+    // whether all buffers are in flight, so start() would refuse
+    virtual bool full() const = 0;
+};
+
+
+
+// GPU time of the commands between begin() and end() through a ring of
+// timer queries, picked up a few frames later so the CPU never waits.
+// timers must not be nested
+struct GpuTimer {
+    static GpuTimer* create(int ring_size = 4);
+    virtual ~GpuTimer() {}
+    // false if all queries are in flight, end() then does nothing
+    virtual bool begin() = 0;
+    virtual void end() = 0;
+    // the oldest finished measurement in milliseconds, false if there is none
+    virtual bool poll(float& ms) = 0;
 };
 
 
@@ -140,7 +217,13 @@ struct Texture2D {
 struct Framebuffer {
     static Framebuffer* create();
     virtual ~Framebuffer() {}
-    virtual void attach_color(Texture2D* t) = 0;
+    enum { MAX_COLORS = 8 };
+    // the textures become color attachments 0, 1, ... and the draw buffers,
+    // for gl_FragData[0], gl_FragData[1], ... the others are detached
+    virtual void attach_colors(Texture2D* const* ts, int count) = 0;
+    void attach_color(Texture2D* t) { attach_colors(&t, 1); }
+    // slice z of a volume becomes the only color attachment
+    virtual void attach_layer(Texture3D* t, int z) = 0;
     virtual void attach_depth(Texture2D* t) = 0;
     virtual bool is_complete() const = 0;
 };
@@ -148,9 +231,15 @@ struct Framebuffer {
 
 struct Shader {
     static Shader* create(const char* vs, const char* fs);
+    // needs has_compute(). run it with dispatch()
+    static Shader* create_compute(const char* cs);
     virtual ~Shader() {}
     virtual bool has_uniform(std::string const& name) = 0;
+    // whether any uniform changed since the shader was last used for drawing
+    virtual bool has_dirty_uniforms() const = 0;
+    // for a sampler, or for an image2D, bound read-write as level 0
     virtual void set_uniform(std::string const& name, Texture2D* v) = 0;
+    virtual void set_uniform(std::string const& name, Texture3D* v) = 0;
     virtual void set_uniform(std::string const& name, int v) = 0;
     virtual void set_uniform(std::string const& name, float v) = 0;
     virtual void set_uniform(std::string const& name, glm::vec2 const& v) = 0;
@@ -166,6 +255,17 @@ bool init();
 void free();
 void clear(const glm::vec4& color, Framebuffer* fb = nullptr);
 void draw(const RenderState& rs, Shader* shader, VertexArray* va, Framebuffer* fb = nullptr);
+// block until the GPU is done with everything submitted so far
+void finish();
+// upload changed uniforms as a draw would, so has_dirty_uniforms() is false
+// again. for shaders whose work was done some other way
+void update_uniforms(Shader* shader);
+
+// compute shaders, GL 4.3
+bool has_compute();
+void dispatch(Shader* shader, int x, int y, int z = 1);
+// make image stores visible to later draws, dispatches, fetches and reads
+void barrier();
 
 
 } // namespace
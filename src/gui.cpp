@@ -1,10 +1,13 @@
 #include "gui.hpp"
 #include "gfx.hpp"
 #include "fx.hpp"
+#include <cassert>
 #include <cstdarg>
 #include <algorithm>
 #include <array>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <SDL2/SDL.h>
 
 
@@ -16,14 +19,19 @@ using Col = glm::u8vec4;
 
 
 enum {
-    FONT_WIDTH  = 7,
-    FONT_HEIGHT = 12,
+    FONT_WIDTH    = 7,
+    FONT_HEIGHT   = 12,
+    MAX_INSTANCES = 1 << 15, // per frame, more are dropped
 };
 
 
-struct Vertex {
+// one textured, axis-aligned rect. the four corners come from a shared
+// vertex buffer and the rest from this, once per instance
+struct Instance {
     Vec pos;
+    Vec size;
     Vec uv;
+    Vec uv_size; // may be negative for mirrored or zero for stretched texels
     Col col;
 };
 
@@ -61,36 +69,68 @@ enum RectStyle {
 };
 
 
+// a string's size and glyphs, relative to its top left. widgets show
+// mostly the same labels and numbers frame after frame, so the layouts
+// are cached by content
+struct TextLayout {
+    Vec                   size;
+    std::vector<Instance> glyphs;
+};
+
+
+enum { TEXT_CACHE_SIZE = 1024 };
+std::unordered_map<std::string, TextLayout> m_text_cache;
+
+
+const TextLayout& layout_text(const char* text) {
+    static std::string key;
+    key.assign(text);
+    auto it = m_text_cache.find(key);
+    if (it != m_text_cache.end()) return it->second;
+
+    // formatted numbers come and go, start over once there are too many
+    if (m_text_cache.size() >= TEXT_CACHE_SIZE) m_text_cache.clear();
+    TextLayout& l = m_text_cache[key];
+    l.size = { 0, FONT_HEIGHT };
+    Vec p = { 0, 0 };
+    while (char c = *text++) {
+        if (c == '\n') {
+            l.size.y += FONT_HEIGHT;
+            p = { 0, short(p.y + FONT_HEIGHT) };
+            continue;
+        }
+        if (c > 32) {
+            Vec uv = { c % 16 * FONT_WIDTH, c / 16 * FONT_HEIGHT };
+            Vec s  = { FONT_WIDTH, FONT_HEIGHT };
+            l.glyphs.push_back({ p, s, uv, s, { 255, 255, 255, 255 } });
+        }
+        p.x += FONT_WIDTH;
+        l.size.x = std::max(l.size.x, p.x);
+    }
+    return l;
+}
+
+
 class DrawContext {
 public:
 
     void set_active(bool a) { m_active = a; }
 
-    void clear() { m_vertices.clear(); }
+    void clear() { m_instances.clear(); }
 
-    const std::vector<Vertex>& get_vertices() const { return m_vertices; }
+    const std::vector<Instance>& get_instances() const { return m_instances; }
 
     void draw_rect(const Rect& rect, const Col& color) {
-        if (!m_active) return;
-        Vertex vs[] = {
-            { rect.tl(), {0, 0}, color },
-            { rect.bl(), {0, 1}, color },
-            { rect.tr(), {1, 0}, color },
-            { rect.br(), {1, 1}, color },
-        };
-        draw_quad(vs[0], vs[1], vs[2], vs[3]);
+        draw_rect(rect, color, { 0, 0 }, { 1, 1 });
     }
 
     void draw_rect(const Rect& rect, const Col& color, const Vec& uv) {
+        draw_rect(rect, color, uv, rect.size());
+    }
+
+    void draw_rect(const Rect& rect, const Col& color, const Vec& uv, const Vec& uv_size) {
         if (!m_active) return;
-        Vec s = rect.size();
-        Vertex vs[] = {
-            { rect.tl(), uv, color },
-            { rect.bl(), uv + Vec(0, s.y), color },
-            { rect.tr(), uv + Vec(s.x, 0), color },
-            { rect.br(), uv + s, color },
-        };
-        draw_quad(vs[0], vs[1], vs[2], vs[3]);
+        m_instances.push_back({ rect.min, rect.size(), uv, uv_size, color });
     }
 
     void draw_rect(const Rect& rect, const Col& color, RectStyle style) {
@@ -99,36 +139,18 @@ public:
             draw_rect(rect, color);
             return;
         }
-        Vec o = { 16 * style, 0 };
-        Vec u = { 7, 0 };
-        Vec v = { 0, 7 };
-        Vertex vs[] = {
-            { rect.tl(),     o,     color },
-            { rect.tl() + v, o + v, color },
-            { rect.bl() - v, o + v, color },
-            { rect.bl(),     o,     color },
-            { rect.tl() + u,     o + u,     color },
-            { rect.tl() + u + v, o + u + v, color },
-            { rect.bl() + u - v, o + u + v, color },
-            { rect.bl() + u,     o + u,     color },
-            { rect.tr() - u,     o + u,     color },
-            { rect.tr() - u + v, o + u + v, color },
-            { rect.br() - u - v, o + u + v, color },
-            { rect.br() - u,     o + u,     color },
-            { rect.tr(),     o,     color },
-            { rect.tr() + v, o + v, color },
-            { rect.br() - v, o + v, color },
-            { rect.br(),     o,     color },
-        };
-        draw_quad(vs[0], vs[1], vs[4], vs[5]);
-        draw_quad(vs[1], vs[2], vs[5], vs[6]);
-        draw_quad(vs[2], vs[3], vs[6], vs[7]);
-        draw_quad(vs[4], vs[5], vs[8], vs[9]);
-        if (style < RECT_STROKE) draw_quad(vs[5], vs[6], vs[9], vs[10]);
-        draw_quad(vs[6], vs[7], vs[10], vs[11]);
-        draw_quad(vs[8], vs[9], vs[12], vs[13]);
-        draw_quad(vs[9], vs[10], vs[13], vs[14]);
-        draw_quad(vs[10], vs[11], vs[14], vs[15]);
+        // nine patches, the corners mirrored from one 7x7 quarter in the texture
+        Vec   o    = { 16 * style, 0 };
+        short xs[] = { rect.min.x, short(rect.min.x + 7), short(rect.max.x - 7), rect.max.x };
+        short ys[] = { rect.min.y, short(rect.min.y + 7), short(rect.max.y - 7), rect.max.y };
+        short us[] = { 0, 7, 7, 0 };
+        for (int j = 0; j < 3; ++j)
+        for (int i = 0; i < 3; ++i) {
+            if (i == 1 && j == 1 && style >= RECT_STROKE) continue;
+            Rect r  = { Vec(xs[i], ys[j]), Vec(xs[i + 1], ys[j + 1]) };
+            Vec  uv = o + Vec(us[i], us[j]);
+            draw_rect(r, color, uv, Vec(us[i + 1] - us[i], us[j + 1] - us[j]));
+        }
     }
 
     void draw_glyph(const Vec& pos, const Col& color, uint8_t c) {
@@ -139,34 +161,15 @@ public:
     }
     void draw_text(const Vec& pos, const char* text) {
         if (!m_active) return;
-        Vec p = pos;
-        while (char c = *text++) {
-            if (c == 10) {
-                p.y += FONT_HEIGHT;
-                p.x = pos.x;
-                continue;
-            }
-            if (c > 32 || c < 128) draw_glyph(p, { 255, 255, 255, 255 }, c);
-            p.x += FONT_WIDTH;
+        for (const Instance& g : layout_text(text).glyphs) {
+            m_instances.push_back(g);
+            m_instances.back().pos += pos;
         }
     }
 
 private:
-    void draw_quad(const Vertex& v0,
-                   const Vertex& v1,
-                   const Vertex& v2,
-                   const Vertex& v3)
-    {
-        m_vertices.emplace_back(v0);
-        m_vertices.emplace_back(v1);
-        m_vertices.emplace_back(v2);
-        m_vertices.emplace_back(v2);
-        m_vertices.emplace_back(v1);
-        m_vertices.emplace_back(v3);
-    }
-
-    bool                m_active;
-    std::vector<Vertex> m_vertices;
+    bool                  m_active;
+    std::vector<Instance> m_instances;
 };
 
 
@@ -179,6 +182,15 @@ struct Window {
     Rect        current_line;
     Rect        content_rect;
     DrawContext dc;
+
+    // the instances are kept from frame to frame and only recorded again
+    // once input or a change in the widgets' content hash makes them stale
+    bool        begun     = false; // this frame
+    bool        shown     = false; // in the uploaded instances
+    bool        dirty     = true;
+    bool        recording = false; // this frame
+    uint64_t    hash      = 0;
+    uint64_t    old_hash  = 0;
 };
 
 
@@ -201,7 +213,10 @@ Window*                              m_window_hovered;
 gfx::Texture2D*                      m_texture;
 gfx::Shader*                         m_shader;
 gfx::VertexArray*                    m_va;
-gfx::VertexBuffer*                   m_vb;
+gfx::StreamBuffer*                   m_stream;
+gfx::VertexBuffer*                   m_corners;
+int                                  m_instance_count = 0; // of all windows, back to front
+bool                                 m_instances_dirty = true;
 
 std::array<char, 1024>               m_text_buffer;
 
@@ -219,6 +234,18 @@ void print_to_text_buffer(const char* fmt, ...) {
 }
 
 
+// FNV-1a over everything that goes into a window's look
+void hash(Window* w, const void* data, size_t size) {
+    auto p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) w->hash = (w->hash ^ p[i]) * 0x100000001b3ull;
+}
+template <class T>
+void hash(Window* w, const T& v) { hash(w, &v, sizeof(v)); }
+void hash(Window* w, const char* s) { hash(w, s, strlen(s) + 1); }
+// without this a char* would pick the template and hash the pointer
+void hash(Window* w, char* s) { hash(w, (const char*) s); }
+
+
 Window* find_or_create_window(const char* name) {
     for (auto& w : m_windows) {
         if (strcmp(w->name, name) == 0) return w.get();
@@ -237,6 +264,7 @@ Window* find_or_create_window(const char* name) {
 
 void move_window_to_front(Window* w) {
     if (w != m_windows.back().get()) {
+        m_instances_dirty = true;
         for (auto it = m_windows.begin(); it != m_windows.end(); ++it) {
             if (it->get() == w) {
                 std::rotate(it, it + 1, m_windows.end());
@@ -262,24 +290,13 @@ Rect new_item_rect(Window* w, const Vec& size) {
     }
     Rect rect = { pos, pos + size };
     w->content_rect.max = glm::max(w->content_rect.max, rect.max);
+    hash(w, rect);
     return rect;
 }
 
 
 Vec text_size(const char* text) {
-    Vec s = { 0, FONT_HEIGHT };
-    short x = 0;
-    while (char c = *text++) {
-        if (c == '\n') {
-            s.y += FONT_HEIGHT;
-            x = 0;
-        }
-        else {
-            x += FONT_WIDTH;
-            s.x = std::max(s.x, x);
-        }
-    }
-    return s;
+    return layout_text(text).size;
 }
 
 
@@ -298,55 +315,88 @@ struct {
     Col frame_hovered  = make_color(0x446688, 100);
     Col frame_active   = make_color(0x447799, 100);
     Col handle         = make_color(0x447799, 200);
+    Col plot           = make_color(0xddaa44, 220);
 } const m_colors;
 
 
+void set_instance_attributes(int offset) {
+    gfx::VertexBuffer* vb = m_stream->get_vertex_buffer();
+    m_va->set_attribute(1, vb, gfx::ComponentType::Int16, 2, false, offset, sizeof(Instance));
+    m_va->set_attribute(2, vb, gfx::ComponentType::Int16, 2, false, offset + 4, sizeof(Instance));
+    m_va->set_attribute(3, vb, gfx::ComponentType::Int16, 2, false, offset + 8, sizeof(Instance));
+    m_va->set_attribute(4, vb, gfx::ComponentType::Int16, 2, false, offset + 12, sizeof(Instance));
+    m_va->set_attribute(5, vb, gfx::ComponentType::Uint8, 4, true, offset + 16, sizeof(Instance));
+}
+
+
 } // namespace
 
 
 void init() {
     m_texture = gfx::Texture2D::create("assets/gui.png", gfx::FilterMode::Nearest);
     m_shader = gfx::Shader::create(
-    R"(#version 100
-    attribute vec2 a_pos;
-    attribute vec2 a_uv;
-    attribute vec4 a_col;
-    varying vec2 v_uv;
-    varying vec4 v_col;
+    R"(#version 130
+    #extension GL_ARB_explicit_attrib_location : require
+    layout(location = 0) in vec2 a_corner;
+    layout(location = 1) in vec2 a_pos;
+    layout(location = 2) in vec2 a_size;
+    layout(location = 3) in vec2 a_uv;
+    layout(location = 4) in vec2 a_uv_size;
+    layout(location = 5) in vec4 a_col;
+    out vec2 v_uv;
+    out vec4 v_col;
     uniform vec2 scale;
     uniform vec2 texture_scale;
     void main() {
-        v_uv = a_uv * texture_scale;
+        v_uv = (a_uv + a_corner * a_uv_size) * texture_scale;
         v_col = a_col;
-        gl_Position = vec4(vec2(2.0, -2.0) * scale * a_pos +
+        gl_Position = vec4(vec2(2.0, -2.0) * scale * (a_pos + a_corner * a_size) +
                            vec2(-1.0, 1.0), 0.0, 1.0);
     })",
-    R"(#version 100
-    precision mediump float;
-    uniform sampler2D texture;
-    varying vec2 v_uv;
-    varying vec4 v_col;
+    R"(#version 130
+    uniform sampler2D tex;
+    in vec2 v_uv;
+    in vec4 v_col;
     void main() {
-        gl_FragColor = v_col * vec4(1.0, 1.0, 1.0, texture2D(texture, v_uv).r);
+        gl_FragColor = v_col * vec4(1.0, 1.0, 1.0, texture2D(tex, v_uv).r);
     })");
-    m_shader->set_uniform("texture", m_texture);
+    m_shader->set_uniform("tex", m_texture);
     m_shader->set_uniform("texture_scale", glm::vec2(1.0f / m_texture->get_width(),
                 1.0f / m_texture->get_height()));
-    m_vb = gfx::VertexBuffer::create(gfx::BufferHint::StreamDraw);
+
+    // tl, bl, tr, br
+    m_corners = gfx::VertexBuffer::create(gfx::BufferHint::StaticDraw);
+    m_corners->init_data(std::vector<glm::u8vec2>{ { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } });
+
+    m_stream = gfx::StreamBuffer::create(MAX_INSTANCES * sizeof(Instance));
     m_va = gfx::VertexArray::create();
-    m_va->set_primitive_type(gfx::PrimitiveType::Triangles);
-    m_va->set_attribute(0, m_vb, gfx::ComponentType::Int16, 2, false, 0, 12);
-    m_va->set_attribute(1, m_vb, gfx::ComponentType::Int16, 2, false, 4, 12);
-    m_va->set_attribute(2, m_vb, gfx::ComponentType::Uint8, 4, true,  8, 12);
+    m_va->set_primitive_type(gfx::PrimitiveType::TriangleStrip);
+    m_va->set_count(4);
+    m_va->set_attribute(0, m_corners, gfx::ComponentType::Uint8, 2, false, 0, 2);
+    set_instance_attributes(0);
+    for (int i = 1; i <= 5; ++i) m_va->set_divisor(i, 1);
+
+    // text of the same width must still change the hash
+    assert([] {
+        Window a;
+        Window b;
+        print_to_text_buffer("fps: %d", 59);
+        hash(&a, m_text_buffer.data());
+        print_to_text_buffer("fps: %d", 60);
+        hash(&b, m_text_buffer.data());
+        return a.hash != b.hash;
+    }());
 }
 
 
 void free() {
     m_windows.clear();
+    m_text_cache.clear();
     delete m_texture;
     delete m_shader;
     delete m_va;
-    delete m_vb;
+    delete m_stream;
+    delete m_corners;
 }
 
 
@@ -369,13 +419,16 @@ void new_frame() {
         b & SDL_BUTTON(SDL_BUTTON_MIDDLE),
         b & SDL_BUTTON(SDL_BUTTON_RIGHT),
     };
+    bool input = m_mouse_wheel != 0;
     for (int i = 0; i < 3; ++i) {
         m_mouse_buttons_clicked[i] = !m_mouse_buttons[i] && bs[i];
+        input |= m_mouse_buttons[i] != bs[i];
         m_mouse_buttons[i] = bs[i];
     }
     Vec p = { x, y };
     m_mouse_mov = p - m_mouse_pos;
     m_mouse_pos = p;
+    input |= m_mouse_mov != Vec(0, 0);
 
     // reset things
     if (!m_mouse_buttons[0]) {
@@ -389,8 +442,21 @@ void new_frame() {
 
     for (int i = (int) m_windows.size() - 1; i >= 0; --i) {
         auto& w = m_windows[i];
-        w->dc.clear();
-        w->dc.set_active(w->content_rect.size() != Vec(0, 0));
+
+        // input under the mouse, now or last frame, may change the looks
+        if (input && (w->rect.contains(m_mouse_pos) || w->rect.contains(m_mouse_pos - m_mouse_mov))) {
+            w->dirty = true;
+        }
+        w->begun     = false;
+        w->recording = w->dirty && w->content_rect.size() != Vec(0, 0);
+        if (w->recording) {
+            w->dirty = false;
+            w->dc.clear();
+            m_instances_dirty = true;
+        }
+        w->dc.set_active(w->recording);
+        w->old_hash = w->hash;
+        w->hash     = 0xcbf29ce484222325ull;
 
         if (!m_window_hovered && w->rect.contains(m_mouse_pos)) m_window_hovered = w.get();
 
@@ -418,14 +484,38 @@ void render() {
     rs.blend_func_src_rgb = gfx::BlendFunc::SrcAlpha;
     rs.blend_func_dst_rgb = gfx::BlendFunc::OneMinusSrcAlpha;
 
-    // render each window separately
+    // content that changed without input shows up a frame late
     for (auto& w : m_windows) {
-        auto& vs = w->dc.get_vertices();
-        if (vs.empty()) continue;
-        m_vb->init_data(vs);
-        m_va->set_count(vs.size());
-        gfx::draw(rs, m_shader, m_va);
+        if (w->hash != w->old_hash) w->dirty = true;
+        if (w->begun != w->shown) m_instances_dirty = true;
+    }
+
+    // all windows in one upload and one draw. windows don't clip their
+    // content, so drawing them back to front is all it takes. the upload
+    // is skipped while all windows are clean
+    if (m_instances_dirty) {
+        m_instances_dirty = false;
+        int total = 0;
+        for (auto& w : m_windows) {
+            if (w->begun) total += w->dc.get_instances().size();
+        }
+        total = std::min<int>(total, MAX_INSTANCES);
+        auto dst = static_cast<Instance*>(m_stream->map(total * sizeof(Instance)));
+        m_instance_count = 0;
+        for (auto& w : m_windows) {
+            w->shown = w->begun;
+            if (!w->begun) continue;
+            auto& is = w->dc.get_instances();
+            int n = std::min<int>(is.size(), total - m_instance_count);
+            std::copy(is.begin(), is.begin() + n, dst + m_instance_count);
+            m_instance_count += n;
+        }
+        set_instance_attributes(m_stream->unmap());
+        m_va->set_instance_count(m_instance_count);
     }
+    if (m_instance_count == 0) return;
+    gfx::draw(rs, m_shader, m_va);
+    m_stream->fence();
 }
 
 
@@ -439,7 +529,8 @@ void begin_window(const char* name) {
     m_window_stack.emplace_back(w);
 
     // have we been here before in this frame?
-    if (!w->dc.get_vertices().empty()) return;
+    if (w->begun) return;
+    w->begun = true;
 
     bool hovered = w == m_window_hovered;
     bool clicked = hovered && m_mouse_buttons_clicked[0] && !m_old_item_hovered;
@@ -456,6 +547,7 @@ void begin_window(const char* name) {
     Rect title_rect  = { w->rect.min, w->rect.min + text_size(name) + Vec(12) };
     w->rect.max      = glm::max(w->rect.max, title_rect.max);
     title_rect.max.x = w->rect.max.x;
+    hash(w, w->rect);
 
     w->dc.draw_rect(w->rect, m_colors.window, RECT_FILL_ROUND_3);
     w->dc.draw_rect(title_rect, m_colors.window_title, RECT_FILL_ROUND_3);
@@ -500,6 +592,7 @@ void text(const char* fmt, ...) {
     va_end(args);
 
     Rect rect = new_item_rect(w, text_size(m_text_buffer.data()) + Vec(4));
+    hash(w, m_text_buffer.data());
 
     w->dc.draw_text(rect.min + Vec(2), m_text_buffer.data());
 }
@@ -519,6 +612,8 @@ bool button(const char* label) {
         move_window_to_front(w);
     }
     bool active = m_item_active == label;
+    hash(w, label);
+    hash(w, hovered | active << 1);
 
     Col color = active  ? m_colors.button_active :
                 hovered ? m_colors.button_hovered :
@@ -552,6 +647,8 @@ bool checkbox(const char* label, bool& v) {
         v = !v;
     }
     bool active = m_item_active == label;
+    hash(w, label);
+    hash(w, hovered | active << 1 | v << 2);
 
     // draw check
     {
@@ -597,6 +694,8 @@ bool radio_button(const char* label, int& v, int value) {
         v = value;
     }
     bool active = m_item_active == label;
+    hash(w, label);
+    hash(w, hovered | active << 1 | (v == value) << 2);
 
     // draw check
     {
@@ -651,6 +750,9 @@ bool drag_float(const char* label, float& v, float speed, float min, float max,
         }
     }
     bool changed = v != old_v;
+    hash(w, label);
+    hash(w, hovered | active << 1);
+    hash(w, glm::vec3(v, min, max));
 
     // draw item
     {
@@ -682,4 +784,78 @@ bool drag_float(const char* label, float& v, float speed, float min, float max,
 }
 
 
+namespace {
+
+
+void plot(const char* label, const float* values, int count, int offset,
+          float min, float max, Vec size, bool lines)
+{
+    Window* w = m_window_stack.back();
+
+    if (size.x == 0) size.x = item_width_default + 12;
+    if (size.y == 0) size.y = 4 * FONT_HEIGHT;
+    Vec s = text_size(label);
+    Rect rect = new_item_rect(w, Vec(size.x + s.x + 4, std::max<short>(size.y, s.y + 12)));
+
+    hash(w, label);
+    hash(w, values, count * sizeof(float));
+    hash(w, glm::vec2(min, max));
+    hash(w, offset);
+
+    Rect plot_rect = { rect.min, rect.min + size };
+    Rect bb = plot_rect.expand(-2);
+    w->dc.draw_rect(bb, m_colors.frame, RECT_FILL_ROUND_1);
+    w->dc.draw_text(plot_rect.tr() + Vec(2, 6), label);
+    if (count <= 0) return;
+
+    if (min == max) {
+        min = std::min(0.0f, *std::min_element(values, values + count));
+        max = *std::max_element(values, values + count);
+        if (min == max) max = min + 1;
+    }
+
+    Rect area = bb.expand(-3);
+    Vec  as   = area.size();
+    auto y_of = [&](int i) {
+        float v = glm::clamp((values[(offset + i) % count] - min) / (max - min), 0.0f, 1.0f);
+        return short(area.max.y - v * as.y);
+    };
+    if (lines) {
+        Vec prev = { area.min.x, y_of(0) };
+        for (int i = 1; i < count; ++i) {
+            Vec p = { short(area.min.x + i * (as.x - 1) / std::max(1, count - 1)), y_of(i) };
+            // a rect spanning the segment, thin enough to pass for a line
+            Rect r = { Vec(prev.x, std::min(prev.y, p.y)),
+                       Vec(std::max<short>(p.x, prev.x + 1), std::max(prev.y, p.y) + 1) };
+            w->dc.draw_rect(r, m_colors.plot);
+            prev = p;
+        }
+    }
+    else {
+        for (int i = 0; i < count; ++i) {
+            short x0 = area.min.x + i * as.x / count;
+            short x1 = area.min.x + (i + 1) * as.x / count;
+            w->dc.draw_rect({ Vec(x0, y_of(i)), Vec(std::max<short>(x1 - 1, x0 + 1), area.max.y) }, m_colors.plot);
+        }
+    }
+}
+
+
+} // namespace
+
+
+void plot_lines(const char* label, const float* values, int count, int offset,
+                float min, float max, Vec size)
+{
+    plot(label, values, count, offset, min, max, size, true);
+}
+
+
+void plot_histogram(const char* label, const float* values, int count, int offset,
+                    float min, float max, Vec size)
+{
+    plot(label, values, count, offset, min, max, size, false);
+}
+
+
 } // namespace
@@ -26,4 +26,11 @@ namespace gui {
     bool checkbox(const char* label, bool& v);
     bool radio_button(const char* label, int& v, int value);
     bool drag_float(const char* label, float& v, float speed = 1, float min = 0, float max = 0, const char* fmt = "%.3f");
+
+    // plot values[(offset + i) % count] for i = 0 .. count - 1, oldest first.
+    // with min == max the range is fit to the values
+    void plot_lines(const char* label, const float* values, int count, int offset = 0,
+                    float min = 0, float max = 0, Vec size = Vec(0, 0));
+    void plot_histogram(const char* label, const float* values, int count, int offset = 0,
+                        float min = 0, float max = 0, Vec size = Vec(0, 0));
 }
@@ -0,0 +1,302 @@
+#include "image.hpp"
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <zlib.h>
+
+
+namespace image {
+
+namespace {
+
+
+uint8_t to_u8(float f) {
+    return uint8_t(std::min(std::max(f, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+
+class PngWriter : public Writer {
+public:
+    ~PngWriter() override {
+        if (!m_file) return;
+        if (m_row != m_height) fprintf(stderr, "png: only %d of %d rows written\n", m_row, m_height);
+        deflate_data(nullptr, 0, Z_FINISH);
+        deflateEnd(&m_stream);
+        write_chunk("IEND", nullptr, 0);
+        fclose(m_file);
+    }
+
+    bool init(const char* filename, int w, int h) {
+        m_width  = w;
+        m_height = h;
+        if (deflateInit(&m_stream, Z_DEFAULT_COMPRESSION) != Z_OK) return false;
+        m_file = fopen(filename, "wb");
+        if (!m_file) {
+            deflateEnd(&m_stream);
+            return false;
+        }
+
+        static const uint8_t signature[] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        fwrite(signature, 1, sizeof(signature), m_file);
+        uint8_t ihdr[13];
+        put_u32(ihdr + 0, w);
+        put_u32(ihdr + 4, h);
+        ihdr[8]  = 8; // bit depth
+        ihdr[9]  = 6; // RGBA
+        ihdr[10] = 0;
+        ihdr[11] = 0;
+        ihdr[12] = 0;
+        write_chunk("IHDR", ihdr, sizeof(ihdr));
+        m_line.resize(1 + w * 4);
+        return true;
+    }
+
+    bool write_rows(float const* rgba, int rows) override {
+        for (int y = 0; y < rows && m_row < m_height; ++y, ++m_row) {
+            m_line[0] = 0; // no filter
+            for (int i = 0; i < m_width * 4; ++i) m_line[1 + i] = to_u8(rgba[i]);
+            rgba += m_width * 4;
+            if (!deflate_data(m_line.data(), m_line.size(), Z_NO_FLUSH)) return false;
+        }
+        return !ferror(m_file);
+    }
+
+    bool write_rows(uint8_t const* rgba, int rows) override {
+        for (int y = 0; y < rows && m_row < m_height; ++y, ++m_row) {
+            m_line[0] = 0;
+            std::copy(rgba, rgba + m_width * 4, &m_line[1]);
+            rgba += m_width * 4;
+            if (!deflate_data(m_line.data(), m_line.size(), Z_NO_FLUSH)) return false;
+        }
+        return !ferror(m_file);
+    }
+
+private:
+    static void put_u32(uint8_t* p, uint32_t v) {
+        p[0] = v >> 24;
+        p[1] = v >> 16;
+        p[2] = v >> 8;
+        p[3] = v;
+    }
+
+    void write_chunk(const char* type, uint8_t const* data, uint32_t size) {
+        uint8_t b[4];
+        put_u32(b, size);
+        fwrite(b, 1, 4, m_file);
+        fwrite(type, 1, 4, m_file);
+        if (size) fwrite(data, 1, size, m_file);
+        uint32_t crc = crc32(0, reinterpret_cast<const Bytef*>(type), 4);
+        if (size) crc = crc32(crc, data, size);
+        put_u32(b, crc);
+        fwrite(b, 1, 4, m_file);
+    }
+
+    // compress into a fixed buffer and emit an IDAT chunk whenever it fills up
+    bool deflate_data(uint8_t const* data, size_t size, int flush) {
+        m_stream.next_in  = const_cast<Bytef*>(data);
+        m_stream.avail_in = size;
+        for (;;) {
+            m_stream.next_out  = m_idat.data();
+            m_stream.avail_out = m_idat.size();
+            int r = deflate(&m_stream, flush);
+            if (r == Z_STREAM_ERROR) return false;
+            size_t n = m_idat.size() - m_stream.avail_out;
+            if (n > 0) write_chunk("IDAT", m_idat.data(), n);
+            if (flush == Z_FINISH ? r == Z_STREAM_END : m_stream.avail_out != 0) return true;
+        }
+    }
+
+    FILE*                        m_file   = nullptr;
+    int                          m_width  = 0;
+    int                          m_height = 0;
+    int                          m_row    = 0;
+    z_stream                     m_stream = {};
+    std::vector<uint8_t>         m_line;
+    std::array<uint8_t, 1 << 16> m_idat;
+};
+
+
+// uncompressed float RGB with one strip per row. the strip tables and the
+// directory are written after the pixel data and the header's directory
+// offset is patched in at the end.
+class TiffWriter : public Writer {
+public:
+    ~TiffWriter() override {
+        if (!m_file) return;
+        if (m_row != m_height) fprintf(stderr, "tiff: only %d of %d rows written\n", m_row, m_height);
+        write_directory();
+        fclose(m_file);
+    }
+
+    bool init(const char* filename, int w, int h) {
+        m_width    = w;
+        m_height   = h;
+        m_row_size = uint64_t(w) * 3 * sizeof(float);
+        // everything up to the end of the directory must have 32 bit offsets:
+        // header, pixels, two strip tables of a LONG per row and the rest of
+        // the directory, which is well below 1 KiB
+        m_big      = 8 + m_row_size * h + 8ull * h + 1024 > UINT32_MAX;
+        m_file = fopen(filename, "wb");
+        if (!m_file) return false;
+        if (m_big) {
+            // BigTIFF: version 43, offset size 8, directory offset patched later
+            put(uint16_t(0x4949));
+            put(uint16_t(43));
+            put(uint16_t(8));
+            put(uint16_t(0));
+            put(uint64_t(0));
+        }
+        else {
+            put(uint16_t(0x4949));
+            put(uint16_t(42));
+            put(uint32_t(0));
+        }
+        m_data_offset = ftell(m_file);
+        m_line.resize(w * 3);
+        return true;
+    }
+
+    bool write_rows(float const* rgba, int rows) override {
+        for (int y = 0; y < rows && m_row < m_height; ++y, ++m_row) {
+            for (int x = 0; x < m_width; ++x) {
+                m_line[x * 3 + 0] = rgba[x * 4 + 0];
+                m_line[x * 3 + 1] = rgba[x * 4 + 1];
+                m_line[x * 3 + 2] = rgba[x * 4 + 2];
+            }
+            rgba += m_width * 4;
+            if (fwrite(m_line.data(), m_row_size, 1, m_file) != 1) return false;
+        }
+        return true;
+    }
+
+    bool write_rows(uint8_t const* rgba, int rows) override {
+        for (int y = 0; y < rows && m_row < m_height; ++y, ++m_row) {
+            for (int x = 0; x < m_width * 3; ++x) m_line[x] = rgba[x / 3 * 4 + x % 3] * (1.0f / 255.0f);
+            rgba += m_width * 4;
+            if (fwrite(m_line.data(), m_row_size, 1, m_file) != 1) return false;
+        }
+        return true;
+    }
+
+private:
+    enum { SHORT = 3, LONG = 4, LONG8 = 16 };
+
+    template<class T>
+    void put(T v) { fwrite(&v, sizeof(T), 1, m_file); }
+
+    void put_offset(uint64_t v) {
+        if (m_big) put(v);
+        else put(uint32_t(v));
+    }
+
+    struct Entry {
+        uint16_t              tag;
+        uint16_t              type;
+        std::vector<uint64_t> values;
+    };
+
+    static int type_size(uint16_t type) {
+        return type == SHORT ? 2 : type == LONG ? 4 : 8;
+    }
+
+    void put_value(uint16_t type, uint64_t v) {
+        if (type == SHORT) put(uint16_t(v));
+        else if (type == LONG) put(uint32_t(v));
+        else put(v);
+    }
+
+    void write_directory() {
+        uint16_t offset_type = m_big ? LONG8 : LONG;
+        std::vector<uint64_t> offsets(m_height);
+        std::vector<uint64_t> counts(m_height, m_row_size);
+        for (int y = 0; y < m_height; ++y) offsets[y] = m_data_offset + y * m_row_size;
+
+        std::vector<Entry> entries = {
+            { 256, LONG,        { uint64_t(m_width) } },
+            { 257, LONG,        { uint64_t(m_height) } },
+            { 258, SHORT,       { 32, 32, 32 } },
+            { 259, SHORT,       { 1 } },          // no compression
+            { 262, SHORT,       { 2 } },          // RGB
+            { 273, offset_type, offsets },
+            { 277, SHORT,       { 3 } },
+            { 278, LONG,        { 1 } },          // rows per strip
+            { 279, offset_type, counts },
+            { 284, SHORT,       { 1 } },          // chunky
+            { 339, SHORT,       { 3, 3, 3 } },    // IEEE float
+        };
+
+        // values that don't fit into an entry go in front of the directory
+        size_t inline_size = m_big ? 8 : 4;
+        std::vector<uint64_t> value_offsets(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            Entry const& e = entries[i];
+            if (e.values.size() * type_size(e.type) <= inline_size) continue;
+            value_offsets[i] = ftell(m_file);
+            for (uint64_t v : e.values) put_value(e.type, v);
+        }
+        if (ftell(m_file) & 1) put(uint8_t(0));
+
+        uint64_t dir_offset = ftell(m_file);
+        if (m_big) put(uint64_t(entries.size()));
+        else put(uint16_t(entries.size()));
+        for (size_t i = 0; i < entries.size(); ++i) {
+            Entry const& e = entries[i];
+            put(e.tag);
+            put(e.type);
+            put_offset(e.values.size());
+            size_t size = e.values.size() * type_size(e.type);
+            if (size <= inline_size) {
+                for (uint64_t v : e.values) put_value(e.type, v);
+                for (; size < inline_size; ++size) put(uint8_t(0));
+            }
+            else put_offset(value_offsets[i]);
+        }
+        put_offset(0); // no next directory
+
+        fseek(m_file, m_big ? 8 : 4, SEEK_SET);
+        put_offset(dir_offset);
+    }
+
+    FILE*              m_file        = nullptr;
+    bool               m_big         = false;
+    int                m_width       = 0;
+    int                m_height      = 0;
+    int                m_row         = 0;
+    uint64_t           m_row_size    = 0;
+    uint64_t           m_data_offset = 0;
+    std::vector<float> m_line;
+};
+
+
+bool has_extension(std::string const& name, const char* ext) {
+    size_t n = strlen(ext);
+    return name.size() >= n && name.compare(name.size() - n, n, ext) == 0;
+}
+
+
+} // namespace
+
+
+Writer* Writer::create(const char* filename, int width, int height) {
+    std::string name = filename;
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if (has_extension(name, ".png")) {
+        auto w = new PngWriter;
+        if (w->init(filename, width, height)) return w;
+        delete w;
+    }
+    else if (has_extension(name, ".tif") || has_extension(name, ".tiff")) {
+        auto w = new TiffWriter;
+        if (w->init(filename, width, height)) return w;
+        delete w;
+    }
+    else fprintf(stderr, "unknown image format '%s'\n", filename);
+    return nullptr;
+}
+
+
+} // namespace
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+
+
+namespace image {
+
+
+// streams an image to disk row by row, so the whole image never has to be
+// in memory. the format is picked from the file extension: .png writes 8 bit
+// RGBA, .tif/.tiff writes 32 bit float RGB (BigTIFF if it gets too large).
+// the file is finished when the writer is deleted.
+struct Writer {
+    static Writer* create(const char* filename, int width, int height);
+    virtual ~Writer() {}
+    // append rows of RGBA floats, top to bottom
+    virtual bool write_rows(float const* rgba, int rows) = 0;
+    // same with RGBA bytes
+    virtual bool write_rows(uint8_t const* rgba, int rows) = 0;
+};
+
+
+} // namespace
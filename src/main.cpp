@@ -1,11 +1,25 @@
 #include "fx.hpp"
 #include "gfx.hpp"
 #include "gui.hpp"
+#include "image.hpp"
+#include "options.hpp"
+#include "farm.hpp"
+#include "record.hpp"
+#include "clock.hpp"
+#include "session.hpp"
+#include "path.hpp"
+#include "reduce.hpp"
+#include "texcache.hpp"
+#include "native.hpp"
+#include "tiles.hpp"
 #include <fstream>
 #include <sstream>
 #include <regex>
 #include <SDL2/SDL.h>
 #include <algorithm>
+#include <array>
+#include <deque>
+#include <dlfcn.h>
 #include <uv.h>
 
 
@@ -18,19 +32,95 @@ struct Variable {
 };
 
 
+struct Channel {
+    std::string        name;
+    float              ratio   = 1;
+    gfx::TextureFormat format  = gfx::TextureFormat::RGBA32F;
+    gfx::Texture2D*    texture = nullptr;
+    gfx::Texture2D*    history = nullptr; // last frame's output, if the writer samples iHistory
+    uint32_t           version = 0;       // bumped whenever the content changes
+    reduce::Target*    stats   = nullptr; // if the writer asked for stats
+    uint32_t           stats_version = -1;
+    bool               mips    = false;   // the mip chain is rebuilt after each write
+    int                image   = -1;      // cache key, if loaded from a file instead of written
+};
+
+
+// rolling values for the gui plots
+struct History {
+    enum { SIZE = 120 };
+    std::array<float, SIZE> values = {};
+    int                     pos    = 0; // of the oldest value
+    int                     count  = 0;
+
+    void push(float v) {
+        values[pos] = v;
+        pos   = (pos + 1) % SIZE;
+        count = std::min(count + 1, int(SIZE));
+    }
+    float last() const { return values[(pos + SIZE - 1) % SIZE]; }
+    float mean() const {
+        float sum = 0;
+        for (float v : values) sum += v;
+        return count > 0 ? sum / count : 0;
+    }
+};
+
+
+// compute passes run in square work groups of this edge length
+enum { COMPUTE_GROUP = 16 };
+
+
+struct Pass {
+    std::string           name;
+    gfx::Shader*          shader = nullptr;
+    int                   output = -1; // channel index, the first of outputs
+    std::vector<int>      outputs;     // channel indices, written to gl_FragData[0], [1], ...
+    bool                  compute = false; // writes its outputs through iOut0, iOut1, ...
+    std::vector<int>      inputs;      // channel indices, bound to iChannel0, iChannel1, ...
+    std::vector<int>      sampled;     // the inputs the shader actually samples
+    std::vector<uint32_t> seen;        // their versions when the pass was last drawn
+    gfx::Shader*          cost_shader = nullptr; // counts the $cost() ticks, in cost mode
+    gfx::Texture2D*       cost        = nullptr; // the counts, sized like the output
+    gfx::GpuTimer*        timer       = nullptr;
+    History               gpu_ms;                // per draw
+    void*                 library     = nullptr; // of a native pass, which runs on the CPU
+    native::RenderFunc    native      = nullptr;
+    std::vector<float>    pixels;                // what it rendered, before the upload
+};
+
+
+// a distance field, baked from the map() of a volume section
+struct Volume {
+    std::string     name;
+    float           extent  = 1; // the grid covers [-extent, extent]^3
+    gfx::Shader*    shader  = nullptr;
+    gfx::Texture3D* texture = nullptr;
+    bool            baked   = false;
+};
+
+
 class App : public fx::App {
 public:
-    App(char* const path) : m_path(path) {}
+    App(Options const& options) : m_options(options), m_path(options.path) {}
 
     void init() override;
 
     void free() override {
+        stop_recording();
+        delete m_log;
+        delete m_replay;
         uv_loop_close(m_loop);
         gui::free();
         delete m_va;
         delete m_vb;
-        for (gfx::Shader* s : m_shaders) delete s;
-        for (gfx::Texture2D* c : m_channels) delete c;
+        delete m_cost_stats;
+        delete m_reducer;
+        free_passes();
+        delete m_images;
+        delete m_tiles;
+        delete m_cost_total;
+        delete m_heat_shader;
 
         delete m_framebuffer;
         delete m_scale_shader;
@@ -50,10 +140,26 @@ public:
         if (code == SDL_SCANCODE_RETURN) {
             printf("%f, %f, %f | %f, %f\n", m_pos.x, m_pos.y, m_pos.z, m_ang.x, m_ang.y);
         }
-        int old_scale = m_scale;
         if (code == SDL_SCANCODE_EQUALS) ++m_scale;
         if (code == SDL_SCANCODE_MINUS) m_scale = std::max(1, m_scale - 1);
-        if (m_scale != old_scale) init_channels();
+        if (code == SDL_SCANCODE_F8) {
+            m_cost = !m_cost;
+            load_shader();
+            m_reloaded = true;
+        }
+        if (code == SDL_SCANCODE_F9) {
+            if (m_recorder) stop_recording();
+            else start_recording();
+        }
+        if (code == SDL_SCANCODE_K) {
+            m_camera_path.add(m_pos, m_ang);
+            if (m_camera_path.save(camera_file())) printf("path: %d keys\n", m_camera_path.size());
+            else printf("cannot write %s\n", camera_file());
+        }
+        if (code == SDL_SCANCODE_P && !m_camera_path.empty()) {
+            m_playing    = !m_playing;
+            m_play_start = m_clock.time();
+        }
     }
 
     void update() override;
@@ -61,14 +167,70 @@ public:
 private:
 
     void load_shader();
+    void free_passes();
+    void schedule_passes();
     void init_channels();
+    void update_eye();
     void update_view();
+    void update_resolution();
+    void update_variables();
+    void update_offline();
+    bool finish_tile(farm::Job const& job);
+    bool finish_frame(farm::Job const& job);
+    void frame_geometry(Channel const& out, glm::vec2& res, glm::vec2& offset) const;
+    void set_uniforms(Pass const& pass, gfx::Shader* shader);
+    void render_native(Pass& pass, Channel& out);
+    bool bake_volumes();
+    int  render_passes();
+    void render_cost();
+    void start_recording();
+    void stop_recording();
+    void update_recording();
+    bool drain_readback(bool wait);
+    bool replay_frame();
+    void time_frame();
+    void report_timings();
+    void log_frame();
+
+    // headless runs that measure frame times
+    bool timing() const { return m_replay || m_options.play; }
+
+    void plot_times();
+
+    const char* camera_file() const { return m_options.camera ? m_options.camera : "camera.path"; }
+
+    bool poster() const { return m_options.poster.x > 0; }
+
+    static void alloc_callback(uv_handle_t*, size_t, uv_buf_t* buf) {
+        static char data[4096];
+        buf->base = data;
+        buf->len  = sizeof(data);
+    }
+
+    // a worker's jobs come in on stdin, one per line
+    static void read_callback(uv_stream_t* stream, ssize_t n, uv_buf_t const* buf) {
+        App* a = (App*) stream->data;
+        if (n < 0) {
+            a->m_input_done = true;
+            uv_close((uv_handle_t*) stream, nullptr);
+            return;
+        }
+        a->m_input_line.append(buf->base, n);
+        size_t end;
+        while ((end = a->m_input_line.find('\n')) != std::string::npos) {
+            farm::Job job;
+            if (farm::parse_job(a->m_input_line.substr(0, end), job)) a->m_jobs.emplace_back(job);
+            else printf("worker: bad job '%s'\n", a->m_input_line.substr(0, end).c_str());
+            a->m_input_line.erase(0, end + 1);
+        }
+    }
 
     static void event_callback(uv_fs_event_t* handle, const char* path, int events, int) {
         App* a = (App*) handle->data;
         if (events & UV_CHANGE) {
             uv_fs_event_stop(handle);
             a->load_shader();
+            a->m_reloaded = true;
             uv_fs_event_start(handle, &event_callback, a->m_path, 0);
         }
     }
@@ -76,34 +238,102 @@ private:
     glm::vec3 m_pos = { 65.861076, 6.651550, -136.457886 };
     glm::vec2 m_ang = { 0.040000, -0.400000 };
     glm::mat3 m_eye;
+    glm::vec3 m_prev_pos;
+    glm::mat3 m_prev_eye;
+    Options               m_options;
     char const*           m_path;
     uv_loop_t*            m_loop;
     uv_fs_event_t         m_handle;
 
     std::vector<Variable> m_variables;
-    uint32_t              m_start_time = SDL_GetTicks();
-    uint32_t              m_frame      = 0;
+    Clock                 m_clock;
+    uint32_t              m_frame = 0;
 
-    std::array<gfx::Shader*, 4>     m_shaders  = {};
-    std::array<gfx::Texture2D*, 4>  m_channels = {};
+    std::vector<Pass>               m_passes;
+    std::vector<Channel>            m_channels;
+    std::vector<int>                m_schedule;      // live passes in execution order
+    std::vector<Volume>             m_volumes;       // bound to iVolume0, iVolume1, ...
+    int                             m_output = -1;   // channel shown on screen
     bool                            m_clear_channels = false;
+    bool                            m_reproject      = false;
+
+    // low-resolution preview while moving
+    enum { IDLE_FRAMES = 8 };
+    bool                            m_preview       = true;
+    int                             m_preview_scale = 4;
+    bool                            m_moving        = false;
+    int                             m_idle_frames   = IDLE_FRAMES;
 
     gfx::RenderState   m_rs;
     gfx::VertexArray*  m_va = nullptr;
     gfx::VertexBuffer* m_vb = nullptr;
 
-    int                m_scale        = 1;
-    gfx::Framebuffer*  m_framebuffer  = nullptr;
-    gfx::Shader*       m_scale_shader = nullptr;
+    int                m_scale         = 1;
+    int                m_channel_scale = 1;
+    gfx::Framebuffer*  m_framebuffer   = nullptr;
+    gfx::Shader*       m_scale_shader  = nullptr;
+
+    reduce::Reducer*   m_reducer       = nullptr;
+    texcache::Cache*   m_images        = nullptr; // for image channels, kept across reloads
+    tiles::Pool*       m_tiles         = nullptr; // for native passes, once there is one
+
+    // for the plots in the debug window
+    uint64_t           m_update_start = 0;
+    History            m_cpu_ms;   // spent in update
+    History            m_frame_ms; // start to start
+
+    // cost mode, F8 toggles it
+    bool               m_cost        = false;
+    gfx::Texture2D*    m_cost_total  = nullptr; // the counts of all passes
+    reduce::Target*    m_cost_stats  = nullptr;
+    gfx::Shader*       m_heat_shader = nullptr;
 
     gfx::Texture2D*    m_overlay_tex    = nullptr;
     gfx::Shader*       m_overlay_shader = nullptr;
+
+    // offline rendering of posters and animations
+    std::deque<farm::Job> m_jobs;
+    int                   m_job_sample = 0;         // frames rendered for the front job
+    glm::vec2             m_offset     = { 0, 0 };  // bottom left of the current tile, in pixels
+    std::vector<float>    m_pixels;
+    farm::Stitcher        m_stitcher;
+    uv_pipe_t             m_input;                  // a worker's stdin
+    std::string           m_input_line;
+    bool                  m_input_done = false;
+
+    // recording of the output channel
+    gfx::Readback*        m_readback = nullptr;
+    record::Recorder*     m_recorder = nullptr;
+    glm::ivec2            m_record_size;
+    int                   m_recorded = 0;
+
+    // session log and replay
+    struct FrameTime {
+        float ms;
+        bool  reload; // includes compiling shaders
+    };
+    session::LogWriter*    m_log         = nullptr;
+    session::LogReader*    m_replay      = nullptr;
+    session::Frame         m_replay_frame;
+    bool                   m_reloaded    = true;   // since the last logged or replayed frame
+    bool                   m_cleared     = false;  // by hand, this frame
+    uint64_t               m_frame_start = 0;
+    std::vector<FrameTime> m_frame_times;
+
+    // camera keyframes, K adds one and P plays them back
+    CameraPath             m_camera_path;
+    bool                   m_playing    = false;
+    float                  m_play_start = 0;
 };
 
 
 void App::init() {
     gui::init();
 
+    if (m_options.fixed || m_options.offline() || m_options.play) m_clock.set_fixed(m_options.fps);
+    m_clock.set_range(m_options.start, m_options.end);
+    m_clock.reset();
+
 //    m_overlay_tex    = gfx::Texture2D::create("overlay.png");
 //    m_overlay_shader = gfx::Shader::create(R"(#version 130
 //void main() { gl_Position = gl_Vertex; }
@@ -128,8 +358,22 @@ uniform vec2 scale;
 void main() {
     gl_FragColor = texture2D(tex, gl_FragCoord.xy * scale);
 }
+)");
+    m_heat_shader = gfx::Shader::create(R"(#version 130
+void main() { gl_Position = gl_Vertex; }
+)", R"(#version 130
+uniform sampler2D tex;
+uniform vec2 scale;
+uniform float max_cost;
+void main() {
+    float v = clamp(texture2D(tex, gl_FragCoord.xy * scale).r / max_cost, 0.0, 1.0) * 3.0;
+    gl_FragColor = vec4(clamp(vec3(v, v - 1.0, v - 2.0), 0.0, 1.0), 0.8);
+}
 )");
     init_channels();
+    m_reducer    = new reduce::Reducer;
+    m_images     = texcache::Cache::create();
+    m_cost_stats = new reduce::Target;
 
     m_vb = gfx::VertexBuffer::create(gfx::BufferHint::StaticDraw);
     m_va = gfx::VertexArray::create();
@@ -147,33 +391,91 @@ void main() {
 
     load_shader();
     m_handle.data = this;
-
     m_loop = uv_default_loop();
-    uv_fs_event_init(m_loop, &m_handle);
-    uv_fs_event_start(&m_handle, &event_callback, m_path, 0);
+
+    if (m_options.replay) {
+        m_replay = new session::LogReader;
+        if (!m_replay->open(m_options.replay)) {
+            printf("cannot open session log %s\n", m_options.replay);
+            delete m_replay;
+            m_replay = nullptr;
+            fx::exit(1);
+        }
+    }
+    else if (m_options.play) {
+        if (!m_camera_path.load(camera_file()) || m_camera_path.empty()) {
+            printf("no camera path in %s\n", camera_file());
+            fx::exit(1);
+        }
+        m_playing    = true;
+        m_play_start = m_clock.time();
+    }
+    else if (!m_options.offline()) {
+        m_camera_path.load(camera_file());
+        uv_fs_event_init(m_loop, &m_handle);
+        uv_fs_event_start(&m_handle, &event_callback, m_path, 0);
+    }
+    else if (m_options.worker) {
+        uv_pipe_init(m_loop, &m_input, 0);
+        uv_pipe_open(&m_input, 0);
+        m_input.data = this;
+        uv_read_start((uv_stream_t*) &m_input, alloc_callback, read_callback);
+    }
+    else {
+        for (farm::Job const& job : farm::make_jobs(m_options)) m_jobs.emplace_back(job);
+        if (poster() && !m_stitcher.init(m_options)) fx::exit(1);
+    }
+
+    if (m_options.record && !m_options.offline()) start_recording();
+    if (m_options.log) {
+        m_log = new session::LogWriter;
+        if (!m_log->open(m_options.log)) {
+            printf("cannot open session log %s\n", m_options.log);
+            delete m_log;
+            m_log = nullptr;
+            fx::exit(1);
+        }
+    }
 }
 
 void App::init_channels() {
     m_clear_channels = true;
-    for (gfx::Texture2D*& c : m_channels) {
-        delete c;
-        c = gfx::Texture2D::create(gfx::TextureFormat::RGBA32F,
-                                   fx::screen_width() / m_scale,
-                                   fx::screen_height() / m_scale,
-                                   nullptr,
-                                   gfx::FilterMode::Linear);
+    std::vector<bool> history(m_channels.size());
+    for (Pass const& pass : m_passes) {
+        if (pass.shader && pass.shader->has_uniform("iHistory")) history[pass.output] = true;
+    }
+    for (int i = 0; i < (int) m_channels.size(); ++i) {
+        Channel& c = m_channels[i];
+        if (c.image >= 0) continue;
+        delete c.texture;
+        delete c.history;
+        c.history = nullptr;
+        int w = std::max(1, int(fx::screen_width() / m_channel_scale * c.ratio));
+        int h = std::max(1, int(fx::screen_height() / m_channel_scale * c.ratio));
+        gfx::FilterMode filter = c.mips ? gfx::FilterMode::Trilinear : gfx::FilterMode::Linear;
+        c.texture = gfx::Texture2D::create(c.format, w, h, nullptr, filter);
+        if (history[i]) c.history = gfx::Texture2D::create(c.format, w, h, nullptr, filter);
+    }
+    for (Pass& pass : m_passes) {
+        delete pass.cost;
+        pass.cost = nullptr;
+        if (!pass.cost_shader) continue;
+        gfx::Texture2D* t = m_channels[pass.output].texture;
+        pass.cost = gfx::Texture2D::create(gfx::TextureFormat::R32F, t->get_width(), t->get_height(),
+                                           nullptr, gfx::FilterMode::Linear);
+    }
+    delete m_cost_total;
+    m_cost_total = nullptr;
+    if (m_cost) {
+        int w = std::max(1, fx::screen_width() / m_channel_scale);
+        int h = std::max(1, fx::screen_height() / m_channel_scale);
+        m_cost_total = gfx::Texture2D::create(gfx::TextureFormat::R32F, w, h);
     }
 }
 
 
-void App::update_view() {
-    glm::vec3 old_pos = m_pos;
-    glm::vec2 old_ang = m_ang;
-
-    const Uint8* ks = SDL_GetKeyboardState(nullptr);
-    m_ang.x += (ks[SDL_SCANCODE_DOWN]  - ks[SDL_SCANCODE_UP]) * 0.02f;
-    m_ang.y += (ks[SDL_SCANCODE_RIGHT] - ks[SDL_SCANCODE_LEFT]) * 0.02f;
-
+// the camera basis for m_ang
+void App::update_eye() {
     float cy = cosf(m_ang.y);
     float sy = sinf(m_ang.y);
     float cx = cosf(m_ang.x);
@@ -188,74 +490,377 @@ void App::update_view() {
         0, cx, sx,
         0, -sx, cx,
     };
+}
 
-    glm::vec3 mov = {
-        ks[SDL_SCANCODE_D]     - ks[SDL_SCANCODE_A],
-        ks[SDL_SCANCODE_SPACE] - ks[SDL_SCANCODE_LSHIFT],
-        ks[SDL_SCANCODE_W]     - ks[SDL_SCANCODE_S],
-    };
-    m_pos += m_eye * mov * 1.0f;
 
-    m_clear_channels |= m_pos != old_pos || m_ang != old_ang || ks[SDL_SCANCODE_RETURN];
+void App::update_view() {
+    glm::vec3 old_pos = m_pos;
+    glm::vec2 old_ang = m_ang;
+    m_prev_pos = m_pos;
+    m_prev_eye = m_eye;
+
+    const Uint8* ks = SDL_GetKeyboardState(nullptr);
+    bool clear = ks[SDL_SCANCODE_RETURN];
+    bool keys  = !m_replay && !m_playing;
+    if (m_replay) {
+        m_pos = m_replay_frame.pos;
+        m_ang = m_replay_frame.ang;
+        clear = m_replay_frame.clear;
+    }
+    else if (m_playing) {
+        m_camera_path.sample(m_camera_path.start() + m_clock.time() - m_play_start, m_pos, m_ang);
+    }
+    else {
+        m_ang.x += (ks[SDL_SCANCODE_DOWN]  - ks[SDL_SCANCODE_UP]) * 0.02f;
+        m_ang.y += (ks[SDL_SCANCODE_RIGHT] - ks[SDL_SCANCODE_LEFT]) * 0.02f;
+    }
+
+    update_eye();
+
+    if (keys) {
+        glm::vec3 mov = {
+            ks[SDL_SCANCODE_D]     - ks[SDL_SCANCODE_A],
+            ks[SDL_SCANCODE_SPACE] - ks[SDL_SCANCODE_LSHIFT],
+            ks[SDL_SCANCODE_W]     - ks[SDL_SCANCODE_S],
+        };
+        m_pos += m_eye * mov * 1.0f;
+    }
+    m_cleared = clear;
+
+    // passes that reproject keep their history across camera moves
+    m_moving         |= m_pos != old_pos || m_ang != old_ang;
+    m_clear_channels |= (m_moving && !m_reproject) || clear;
 }
 
-void App::update() {
-    uv_run(m_loop, UV_RUN_NOWAIT);
-    ++m_frame;
+void App::update_resolution() {
+    // drop to a coarser channel scale while moving and go back to full
+    // resolution once things have been still for a few frames
+    if (m_moving) m_idle_frames = 0;
+    else if (m_idle_frames < IDLE_FRAMES) ++m_idle_frames;
+    m_moving = false;
 
-    update_view();
+    int scale = m_scale;
+    if (m_preview && !m_reproject && !m_recorder && m_idle_frames < IDLE_FRAMES) scale *= m_preview_scale;
+    if (scale != m_channel_scale) {
+        m_channel_scale = scale;
+        init_channels();
+    }
+}
 
+void App::update_variables() {
     for (Variable& v : m_variables) v.rendered = false;
 
-    gui::new_frame();
     gui::set_next_window_pos({5, 5});
     gui::begin_window("Variables");
-    for (gfx::Shader* shader : m_shaders) {
-        if (!shader) break;
-        if (shader->has_uniform("iPos")) shader->set_uniform("iPos", m_pos);
-        if (shader->has_uniform("iEye")) shader->set_uniform("iEye", m_eye);
-        if (shader->has_uniform("iResolution")) {
-            shader->set_uniform("iResolution", glm::vec2(m_channels[0]->get_width(),
-                                                         m_channels[0]->get_height()));
-        }
-        if (shader->has_uniform("iFrame")) shader->set_uniform("iFrame", float(m_frame));
-        if (shader->has_uniform("iTime")) {
-            shader->set_uniform("iTime", (SDL_GetTicks() - m_start_time) * 0.001f);
-        }
-        if (shader->has_uniform("iChannel0")) shader->set_uniform("iChannel0", m_channels[0]);
-        if (shader->has_uniform("iChannel1")) shader->set_uniform("iChannel1", m_channels[1]);
-        if (shader->has_uniform("iChannel2")) shader->set_uniform("iChannel2", m_channels[2]);
-        if (shader->has_uniform("iChannel3")) shader->set_uniform("iChannel3", m_channels[3]);
+    auto show = [this](gfx::Shader* shader) {
+        if (!shader) return;
+        for (Variable& v : m_variables) {
+            if (v.rendered || !shader->has_uniform("_" + v.name)) continue;
+            if (gui::drag_float(v.name.c_str(), v.val, 1, v.min, v.max)) {
+                m_clear_channels = true;
+                m_moving         = true;
+            }
+            v.rendered = true;
+        }
+    };
+    for (Volume const& vol : m_volumes) show(vol.shader);
+    for (Pass const& pass : m_passes) show(pass.shader);
+    gui::end_window();
+}
+
+
+void App::frame_geometry(Channel const& out, glm::vec2& res, glm::vec2& offset) const {
+    glm::vec2 size(out.texture->get_width(), out.texture->get_height());
+    res    = size;
+    offset = { 0, 0 };
+    if (poster()) {
+        // iResolution is the whole poster, iOffset the tile's position in it
+        glm::vec2 k = size / glm::vec2(fx::screen_width(), fx::screen_height());
+        res    = glm::vec2(m_options.poster) * k;
+        offset = m_offset * k;
+    }
+}
+
+
+void App::set_uniforms(Pass const& pass, gfx::Shader* shader) {
+    bool preview = m_channel_scale != m_scale;
+    Channel const& out = m_channels[pass.output];
+    glm::vec2 size(out.texture->get_width(), out.texture->get_height());
+    glm::vec2 res, offset;
+    frame_geometry(out, res, offset);
+    if (shader->has_uniform("iPos")) shader->set_uniform("iPos", m_pos);
+    if (shader->has_uniform("iEye")) shader->set_uniform("iEye", m_eye);
+    if (shader->has_uniform("iPrevPos")) shader->set_uniform("iPrevPos", m_prev_pos);
+    if (shader->has_uniform("iPrevEye")) shader->set_uniform("iPrevEye", m_prev_eye);
+    if (shader->has_uniform("iResolution")) shader->set_uniform("iResolution", res);
+    if (shader->has_uniform("iTileResolution")) shader->set_uniform("iTileResolution", size);
+    if (shader->has_uniform("iOffset")) shader->set_uniform("iOffset", offset);
+    if (shader->has_uniform("iFrame")) shader->set_uniform("iFrame", float(m_frame));
+    if (shader->has_uniform("iPreview")) shader->set_uniform("iPreview", float(preview));
+    if (shader->has_uniform("iTime")) {
+        shader->set_uniform("iTime", m_clock.time());
+    }
+    for (int k = 0; k < (int) pass.inputs.size(); ++k) {
+        Channel const& in = m_channels[pass.inputs[k]];
+        std::string n = std::to_string(k);
+        if (shader->has_uniform("iChannel" + n)) shader->set_uniform("iChannel" + n, in.texture);
+        if (!in.stats) continue;
+        reduce::Stats const& s = in.stats->stats;
+        if (shader->has_uniform("iStats" + n)) {
+            shader->set_uniform("iStats" + n, glm::vec4(s.min, s.max, s.mean, s.nonfinite));
+        }
+        if (shader->has_uniform("iHistogram" + n) && in.stats->result) {
+            shader->set_uniform("iHistogram" + n, in.stats->result);
+        }
+    }
+    if (out.history) shader->set_uniform("iHistory", out.history);
+    for (Variable& v : m_variables) {
+        std::string u = "_" + v.name;
+        if (shader->has_uniform(u)) shader->set_uniform(u, v.val);
+    }
+}
+
+
+// native passes render tile by tile on all cores, into memory that is then
+// uploaded to the output. they see the same uniforms as the GLSL code
+void App::render_native(Pass& pass, Channel& out) {
+    enum { TILE = 32 };
+    int w = out.texture->get_width();
+    int h = out.texture->get_height();
+    glm::vec2 res, offset;
+    frame_geometry(out, res, offset);
+    std::vector<char const*> names;
+    std::vector<float>       values;
+    for (Variable const& v : m_variables) {
+        names.emplace_back(v.name.c_str());
+        values.emplace_back(v.val);
+    }
+    native::Frame f = {};
+    f.version         = native::VERSION;
+    f.time            = m_clock.time();
+    f.frame           = m_frame;
+    f.resolution[0]   = res.x;
+    f.resolution[1]   = res.y;
+    f.offset[0]       = offset.x;
+    f.offset[1]       = offset.y;
+    f.variable_count  = names.size();
+    f.variable_names  = names.data();
+    f.variable_values = values.data();
+    for (int i = 0; i < 3; ++i) f.pos[i] = m_pos[i];
+    for (int i = 0; i < 9; ++i) f.eye[i] = m_eye[i / 3][i % 3];
+
+    pass.pixels.resize(w * h * 4);
+    m_tiles->run(w, h, TILE, [&](int x, int y, int tw, int th) {
+        native::Tile t = { x, y, tw, th, &pass.pixels[(y * w + x) * 4], w };
+        pass.native(&f, &t);
+    });
+    out.texture->set_rows(0, h, pass.pixels.data());
+}
+
+
+// a volume is rebaked only when its variables change, one slice per draw
+bool App::bake_volumes() {
+    bool baked = false;
+    for (Volume& vol : m_volumes) {
+        if (!vol.shader) continue;
         for (Variable& v : m_variables) {
             std::string u = "_" + v.name;
-            if (shader->has_uniform(u)) {
-                shader->set_uniform(u, v.val);
-                if (!v.rendered) {
-                    if (gui::drag_float(v.name.c_str(), v.val, 1, v.min, v.max)) {
-                        m_clear_channels = true;
-                    }
-                    v.rendered = true;
-                }
+            if (vol.shader->has_uniform(u)) vol.shader->set_uniform(u, v.val);
+        }
+        if (vol.baked && !vol.shader->has_dirty_uniforms()) continue;
+        vol.shader->set_uniform("iRes", float(vol.texture->get_width()));
+        if (vol.shader->has_uniform("iExtent")) vol.shader->set_uniform("iExtent", vol.extent);
+        gfx::RenderState rs;
+        for (int z = 0; z < vol.texture->get_depth(); ++z) {
+            vol.shader->set_uniform("iSlice", float(z));
+            m_framebuffer->attach_layer(vol.texture, z);
+            gfx::draw(rs, vol.shader, m_va, m_framebuffer);
+        }
+        vol.baked = true;
+        baked     = true;
+    }
+    return baked;
+}
+
+
+int App::render_passes() {
+    // last frame's output becomes the history, the history gets overwritten
+    for (Channel& c : m_channels) {
+        if (c.history) std::swap(c.texture, c.history);
+    }
+
+    // image channels switch from a blank texture once their file is loaded
+    m_images->poll();
+    for (Channel& c : m_channels) {
+        if (c.image < 0 || c.texture == m_images->get(c.image)) continue;
+        c.texture = m_images->get(c.image);
+        ++c.version;
+    }
+
+    for (Pass const& pass : m_passes) {
+        if (!pass.shader) continue;
+        set_uniforms(pass, pass.shader);
+        if (pass.cost_shader) set_uniforms(pass, pass.cost_shader);
+    }
+
+    bool baked = bake_volumes();
+    for (Pass const& pass : m_passes) {
+        for (int k = 0; k < (int) m_volumes.size(); ++k) {
+            std::string u = "iVolume" + std::to_string(k);
+            if (pass.shader && pass.shader->has_uniform(u)) pass.shader->set_uniform(u, m_volumes[k].texture);
+        }
+    }
+
+    bool clear = m_clear_channels;
+    if (m_clear_channels) {
+        for (Channel& c : m_channels) {
+            if (c.image >= 0) continue;
+            for (gfx::Texture2D* t : { c.texture, c.history }) {
+                if (!t) continue;
+                m_framebuffer->attach_color(t);
+                gfx::clear({}, m_framebuffer);
+            }
+            ++c.version;
+        }
+        m_clear_channels = false;
+    }
+
+    for (Pass& pass : m_passes) {
+        float ms;
+        while (pass.timer && pass.timer->poll(ms)) pass.gpu_ms.push(ms);
+    }
+
+    // redraw a pass only if one of its uniforms or sampled inputs changed
+    int drawn = 0;
+    for (int p : m_schedule) {
+        Pass& pass = m_passes[p];
+        Channel& out = m_channels[pass.output];
+        bool dirty = clear || baked || out.history || pass.shader->has_dirty_uniforms();
+        for (int k = 0; k < (int) pass.sampled.size(); ++k) {
+            uint32_t v = m_channels[pass.sampled[k]].version;
+            if (pass.seen[k] != v) {
+                pass.seen[k] = v;
+                dirty = true;
+            }
+        }
+        if (!dirty) continue;
+        ++drawn;
+        gfx::Texture2D* targets[gfx::Framebuffer::MAX_COLORS];
+        for (int k = 0; k < (int) pass.outputs.size(); ++k) {
+            targets[k] = m_channels[pass.outputs[k]].texture;
+            ++m_channels[pass.outputs[k]].version;
+        }
+        pass.timer->begin();
+        if (pass.native) {
+            render_native(pass, out);
+            // the GLSL code only tracks whether the pass is dirty
+            gfx::update_uniforms(pass.shader);
+        }
+        else if (pass.compute) {
+            // one invocation per output pixel
+            for (int k = 0; k < (int) pass.outputs.size(); ++k) {
+                std::string u = "iOut" + std::to_string(k);
+                if (pass.shader->has_uniform(u)) pass.shader->set_uniform(u, targets[k]);
+            }
+            gfx::dispatch(pass.shader, (out.texture->get_width() + COMPUTE_GROUP - 1) / COMPUTE_GROUP,
+                          (out.texture->get_height() + COMPUTE_GROUP - 1) / COMPUTE_GROUP);
+            gfx::barrier();
+        }
+        else {
+            m_framebuffer->attach_colors(targets, pass.outputs.size());
+            gfx::draw(m_rs, pass.shader, m_va, m_framebuffer);
+        }
+        for (int k = 0; k < (int) pass.outputs.size(); ++k) {
+            if (m_channels[pass.outputs[k]].mips) targets[k]->generate_mipmaps();
+        }
+        pass.timer->end();
+        if (pass.cost_shader) {
+            m_framebuffer->attach_color(pass.cost);
+            gfx::draw(m_rs, pass.cost_shader, m_va, m_framebuffer);
+        }
+    }
+
+    // stats are read back asynchronously and lag a few frames behind
+    for (Channel& c : m_channels) {
+        if (!c.stats) continue;
+        m_reducer->poll(*c.stats);
+        if (c.stats_version == c.version) continue;
+        if (m_reducer->reduce(*c.stats, c.texture, c.format == gfx::TextureFormat::R32F)) {
+            c.stats_version = c.version;
+        }
+    }
+    return drawn;
+}
+
+
+void App::update() {
+    if (m_options.offline()) {
+        // an idle worker sleeps until the next job comes in
+        uv_run(m_loop, m_options.worker && m_jobs.empty() ? UV_RUN_ONCE : UV_RUN_NOWAIT);
+        update_offline();
+        return;
+    }
+    uv_run(m_loop, UV_RUN_NOWAIT);
+
+    uint64_t start = SDL_GetPerformanceCounter();
+    if (m_update_start) {
+        m_frame_ms.push((start - m_update_start) * 1000.0 / SDL_GetPerformanceFrequency());
+    }
+    m_update_start = start;
+
+    ++m_frame;
+    if (timing()) time_frame();
+    if (m_replay) {
+        if (!replay_frame()) {
+            report_timings();
+            return;
+        }
+    }
+    else {
+        m_clock.step();
+        if (m_clock.ended()) {
+            fx::exit(0);
+            return;
+        }
+        if (m_playing && m_clock.time() - m_play_start > m_camera_path.end() - m_camera_path.start()) {
+            m_playing = false;
+            if (m_options.play) {
+                report_timings();
+                return;
             }
         }
     }
 
-    int index = -1;
-    for (gfx::Shader* shader : m_shaders) {
-        if (!shader) break;
-        ++index;
-        m_framebuffer->attach_color(m_channels[index]);
-        if (m_clear_channels) gfx::clear({}, m_framebuffer);
-        gfx::draw(m_rs, shader, m_va, m_framebuffer);
+    update_view();
+    // --play times full frames, not the passes that happen to be skipped
+    if (m_options.play) m_clear_channels = true;
+    update_resolution();
+
+    gui::new_frame();
+    gui::checkbox("preview", m_preview);
+    update_variables();
+    if (m_log) log_frame();
+
+    int drawn = render_passes();
+    gui::text("passes drawn: %d/%d", drawn, int(m_schedule.size()));
+    plot_times();
+    for (Channel const& c : m_channels) {
+        if (!c.stats || !c.stats->stats.valid) continue;
+        reduce::Stats const& s = c.stats->stats;
+        gui::text("%s: min %.3g max %.3g mean %.3g", c.name.c_str(), s.min, s.max, s.mean);
+        gui::text("  ev p50 %.1f p95 %.1f, non-finite %d", s.percentile(0.5f), s.percentile(0.95f),
+                  int(s.nonfinite));
     }
-    m_clear_channels = false;
+    update_recording();
+    if (m_recorder) gui::text("recording: %d frames", m_recorded);
 
-    if (index >= 0) {
+    if (m_output >= 0) {
         gfx::clear({});
-        m_scale_shader->set_uniform("tex", m_channels[index]);
+        m_scale_shader->set_uniform("tex", m_channels[m_output].texture);
         m_scale_shader->set_uniform("scale", 1.0f / glm::vec2(fx::screen_width(), fx::screen_height()));
         gfx::draw(m_rs, m_scale_shader, m_va);
     }
+    if (m_cost) render_cost();
 
     // overlay
 //    gfx::RenderState rs;
@@ -266,6 +871,278 @@ void App::update() {
 //    gfx::draw(rs, m_overlay_shader, m_va);
 
     gui::render();
+
+    // make the frame time include the GPU work
+    if (timing()) gfx::finish();
+
+    m_cpu_ms.push((SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+
+void App::plot_times() {
+    float frame_ms = m_frame_ms.mean();
+    gui::text("%.1f fps", frame_ms > 0 ? 1000 / frame_ms : 0.0f);
+    char label[64];
+    snprintf(label, sizeof(label), "cpu %.2f ms", m_cpu_ms.last());
+    gui::plot_lines(label, m_cpu_ms.values.data(), History::SIZE, m_cpu_ms.pos);
+    for (Pass const& pass : m_passes) {
+        if (!pass.shader || pass.gpu_ms.count == 0) continue;
+        snprintf(label, sizeof(label), "%s %.2f ms", pass.name.c_str(), pass.gpu_ms.last());
+        gui::plot_histogram(label, pass.gpu_ms.values.data(), History::SIZE, pass.gpu_ms.pos,
+                            0, 0, gui::Vec(0, 24));
+    }
+}
+
+
+void App::render_cost() {
+    // sum up the counts of all passes, sampled at the output resolution
+    glm::vec2 size(m_cost_total->get_width(), m_cost_total->get_height());
+    m_framebuffer->attach_color(m_cost_total);
+    gfx::clear({}, m_framebuffer);
+    gfx::RenderState rs;
+    rs.blend_enabled        = true;
+    rs.blend_func_src_rgb   = gfx::BlendFunc::One;
+    rs.blend_func_dst_rgb   = gfx::BlendFunc::One;
+    rs.blend_func_src_alpha = gfx::BlendFunc::One;
+    rs.blend_func_dst_alpha = gfx::BlendFunc::One;
+    m_scale_shader->set_uniform("scale", 1.0f / size);
+    for (Pass const& pass : m_passes) {
+        if (!pass.cost) continue;
+        m_scale_shader->set_uniform("tex", pass.cost);
+        gfx::draw(rs, m_scale_shader, m_va, m_framebuffer);
+    }
+
+    m_reducer->poll(*m_cost_stats);
+    m_reducer->reduce(*m_cost_stats, m_cost_total, true);
+    reduce::Stats const& s = m_cost_stats->stats;
+
+    // heatmap from black over red and yellow to white at the highest count
+    rs.blend_func_src_rgb = gfx::BlendFunc::SrcAlpha;
+    rs.blend_func_dst_rgb = gfx::BlendFunc::OneMinusSrcAlpha;
+    m_heat_shader->set_uniform("tex", m_cost_total);
+    m_heat_shader->set_uniform("scale", 1.0f / glm::vec2(fx::screen_width(), fx::screen_height()));
+    m_heat_shader->set_uniform("max_cost", std::max(s.max, 1.0f));
+    gfx::draw(rs, m_heat_shader, m_va);
+
+    if (s.valid) {
+        gui::text("cost: mean %.1f max %.0f", s.mean, s.max);
+        gui::text("  total %.3g ticks", s.mean * size.x * size.y);
+    }
+}
+
+
+void App::time_frame() {
+    // frames are timed from start to start, so the swap counts too
+    uint64_t now = SDL_GetPerformanceCounter();
+    if (m_frame_start) {
+        float ms = (now - m_frame_start) * 1000.0 / SDL_GetPerformanceFrequency();
+        m_frame_times.push_back({ ms, m_reloaded });
+        m_reloaded = false;
+    }
+    m_frame_start = now;
+}
+
+bool App::replay_frame() {
+    if (!m_replay->read(m_replay_frame)) return false;
+    m_reloaded = m_replay_frame.reload;
+    if (m_reloaded) load_shader();
+    m_clock.set(m_frame, m_replay_frame.time);
+    for (auto const& v : m_replay_frame.variables) {
+        for (Variable& var : m_variables) {
+            if (var.name != v.first || var.val == v.second) continue;
+            var.val          = v.second;
+            m_clear_channels = true;
+            m_moving         = true;
+        }
+    }
+    return true;
+}
+
+void App::report_timings() {
+    // frames that compiled shaders don't count
+    std::vector<float> times;
+    for (FrameTime const& t : m_frame_times) {
+        if (!t.reload) times.emplace_back(t.ms);
+    }
+    session::Stats s = session::compute_stats(times);
+    printf("timing: %d frames, mean %.2f ms, median %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+           s.frames, s.mean, s.median, s.p95, s.p99, s.max);
+
+    if (m_options.timings) {
+        FILE* f = fopen(m_options.timings, "w");
+        if (f) {
+            fprintf(f, "frame,ms,reload\n");
+            for (int i = 0; i < (int) m_frame_times.size(); ++i) {
+                fprintf(f, "%d,%.3f,%d\n", i, m_frame_times[i].ms, m_frame_times[i].reload);
+            }
+            fclose(f);
+        }
+        else printf("cannot write %s\n", m_options.timings);
+    }
+
+    if (m_options.max_p95 > 0 && s.p95 > m_options.max_p95) {
+        printf("timing: p95 is above %.2f ms\n", m_options.max_p95);
+        fx::exit(1);
+    }
+    else fx::exit(0);
+}
+
+void App::log_frame() {
+    session::Frame f;
+    f.time   = m_clock.time();
+    f.pos    = m_pos;
+    f.ang    = m_ang;
+    f.reload = m_reloaded;
+    f.clear  = m_cleared;
+    for (Variable const& v : m_variables) f.variables.emplace_back(v.name, v.val);
+    m_reloaded = false;
+    if (!m_log->write(f)) {
+        printf("cannot write session log %s\n", m_options.log);
+        delete m_log;
+        m_log = nullptr;
+    }
+}
+
+
+void App::update_offline() {
+    // one job at a time, each gets the configured number of frames so
+    // accumulating passes can converge. the window has the size of a tile
+    // or an animation frame, and so do the full size channels
+    if (m_jobs.empty()) {
+        if (!m_options.worker || m_input_done) fx::exit(0);
+        return;
+    }
+    if (m_output < 0) {
+        printf("nothing to render\n");
+        fx::exit(1);
+        return;
+    }
+
+    // time and frame count only depend on the job, so that workers agree
+    farm::Job job = m_jobs.front();
+    int       t   = m_options.tile;
+    if (m_job_sample == 0) m_clear_channels = true;
+    // the camera doesn't move, last frame's is the same
+    update_eye();
+    m_prev_pos = m_pos;
+    m_prev_eye = m_eye;
+    if (job.kind == farm::Job::Tile) {
+        m_offset = glm::vec2(job.x * t, m_options.poster.y - (job.y + 1) * t);
+        m_clock.seek(0);
+        m_frame  = m_job_sample;
+    }
+    else {
+        m_offset = { 0, 0 };
+        m_clock.seek(job.x);
+        m_frame  = job.x * m_options.samples + m_job_sample;
+    }
+    render_passes();
+    if (++m_job_sample < m_options.samples) return;
+    m_job_sample = 0;
+    m_jobs.pop_front();
+
+    gfx::Texture2D* tex = m_channels[m_output].texture;
+    int w = fx::screen_width();
+    int h = fx::screen_height();
+    if (tex->get_width() != w || tex->get_height() != h) {
+        printf("the output channel must be full size\n");
+        fx::exit(1);
+        return;
+    }
+    m_pixels.resize(w * h * 4);
+    tex->get_data(gfx::TextureFormat::RGBA32F, m_pixels.data());
+
+    // textures are bottom up, images top down
+    for (int y = 0; y < h / 2; ++y) {
+        std::swap_ranges(&m_pixels[y * w * 4], &m_pixels[(y + 1) * w * 4], &m_pixels[(h - 1 - y) * w * 4]);
+    }
+
+    bool ok = job.kind == farm::Job::Tile ? finish_tile(job) : finish_frame(job);
+    if (!ok) fx::exit(1);
+}
+
+bool App::finish_tile(farm::Job const& job) {
+    if (m_options.worker) return farm::send_reply(job, m_pixels.data(), m_pixels.size() * sizeof(float));
+    if (!m_stitcher.add(job, m_pixels.data())) return false;
+    printf("poster: %d/%d rows\n", m_stitcher.rows_written(), m_options.poster.y);
+    return true;
+}
+
+bool App::finish_frame(farm::Job const& job) {
+    std::string path = farm::frame_path(m_options.output, job.x);
+    int w = fx::screen_width();
+    int h = fx::screen_height();
+    image::Writer* writer = image::Writer::create(path.c_str(), w, h);
+    bool ok = writer && writer->write_rows(m_pixels.data(), h);
+    delete writer;
+    if (!ok) {
+        printf("cannot write %s\n", path.c_str());
+        return false;
+    }
+    if (m_options.worker) return farm::send_reply(job, nullptr, 0);
+    printf("frame %d/%d\n", job.x, m_options.last);
+    return true;
+}
+
+
+void App::start_recording() {
+    if (m_output < 0) {
+        printf("record: nothing to record\n");
+        return;
+    }
+    const char* target = m_options.record ? m_options.record : "capture_%04d.png";
+    gfx::Texture2D* tex = m_channels[m_output].texture;
+    m_record_size = { tex->get_width(), tex->get_height() };
+    m_recorder    = record::Recorder::create(target, m_record_size.x, m_record_size.y, m_options.fps);
+    if (!m_recorder) return;
+    m_readback = gfx::Readback::create();
+    m_recorded = 0;
+    printf("record: %s\n", target);
+}
+
+void App::stop_recording() {
+    if (!m_recorder) return;
+    drain_readback(true);
+    delete m_readback;
+    delete m_recorder;
+    m_readback = nullptr;
+    m_recorder = nullptr;
+    printf("record: %d frames\n", m_recorded);
+}
+
+// hand finished copies to the encoders. with wait, also the ones in flight
+bool App::drain_readback(bool wait) {
+    int w, h;
+    while (void const* data = m_readback->map(w, h, wait)) {
+        bool ok = m_recorder->push(data);
+        m_readback->unmap();
+        if (!ok) return false;
+        ++m_recorded;
+    }
+    return true;
+}
+
+void App::update_recording() {
+    if (!m_recorder || m_output < 0) return;
+    if (!drain_readback(false)) {
+        stop_recording();
+        return;
+    }
+    gfx::Texture2D* tex = m_channels[m_output].texture;
+    if (glm::ivec2(tex->get_width(), tex->get_height()) != m_record_size) {
+        printf("record: the output size changed\n");
+        stop_recording();
+        return;
+    }
+    if (!m_readback->start(tex)) {
+        // every buffer in flight, wait for the oldest one
+        int w, h;
+        if (void const* data = m_readback->map(w, h, true)) {
+            if (m_recorder->push(data)) ++m_recorded;
+            m_readback->unmap();
+        }
+        m_readback->start(tex);
+    }
 }
 
 
@@ -273,17 +1150,34 @@ class Parser {
 public:
     Parser(std::istream& input) : m_input(input) {}
 
+    bool done() const { return !m_input; }
+
+    // the "---" line that opened the section returned by the last
+    // parse_shader call. empty for the first section
+    std::string const& header() const { return m_header; }
+
     template <class Func>
     std::string parse_shader(Func const& func) {
+        m_header = m_next_header;
+        m_next_header.clear();
         std::stringstream ss;
         std::string line;
         while (std::getline(m_input, line)) {
             ++m_line_count;
-            if (line == "---") break;
+            if (line.compare(0, 3, "---") == 0) {
+                m_next_header = line;
+                break;
+            }
             static const std::regex var_reg(R"(\$(\w+)(\(([^,]+),([^)]+)\))?)");
             std::smatch match;
             while (std::regex_search(line, match, var_reg)) {
                 ss << match.prefix();
+                // $cost() counts a loop iteration in cost mode
+                if (match[1] == "cost") {
+                    ss << "iCostTick";
+                    line = match.suffix();
+                    continue;
+                }
                 ss << '_' << match[1];
                 Variable var { match[1], 0, 1, 0.5f };
                 if (match[2].length() > 0) {
@@ -301,9 +1195,264 @@ public:
 private:
     int           m_line_count = 0;
     std::istream& m_input;
+    std::string   m_header;
+    std::string   m_next_header;
+};
+
+
+struct PassDesc {
+    std::string              name;
+    std::vector<std::string> outputs;
+    std::vector<std::string> inputs;
+    bool                     implicit_inputs = false;
+    float                    ratio  = 1;
+    gfx::TextureFormat       format = gfx::TextureFormat::RGBA32F;
+    bool                     stats  = false;
+    bool                     compute = false;
+    bool                     mips    = false;
+    std::string              library;           // of a native pass
+};
+
+
+// the layout qualifier of a compute pass's output image
+const char* image_format(gfx::TextureFormat f) {
+    switch (f) {
+    case gfx::TextureFormat::RGBA:    return "rgba8";
+    case gfx::TextureFormat::RGBA16F: return "rgba16f";
+    case gfx::TextureFormat::R32F:    return "r32f";
+    case gfx::TextureFormat::R16F:    return "r16f";
+    default:                          return "rgba32f";
+    }
+}
+
+
+gfx::TextureFormat parse_format(std::string const& s) {
+    if (s == "rgba8")   return gfx::TextureFormat::RGBA;
+    if (s == "rgba16f") return gfx::TextureFormat::RGBA16F;
+    if (s == "rgba32f") return gfx::TextureFormat::RGBA32F;
+    if (s == "r32f")    return gfx::TextureFormat::R32F;
+    if (s == "r16f")    return gfx::TextureFormat::R16F;
+    throw std::invalid_argument("unknown format '" + s + "'");
+}
+
+
+struct VolumeDesc {
+    std::string        name;
+    int                res    = 64;
+    float              extent = 1;
+    gfx::TextureFormat format = gfx::TextureFormat::R16F;
+};
+
+
+// "---volume <name> [res=<n>] [extent=<e>] [format=r16f|r32f]" starts a
+// section that defines float map(vec3 p). it is baked into a res^3 grid of
+// distances over the cube [-extent, extent]^3 whenever its variables change.
+// passes get volume k, in the order of the sections, as iVolumeK, along with
+// iVolumeDistK(p): the baked distance, a lower bound of map(p) that is safe
+// for skipping empty space as long as map() is a distance bound
+VolumeDesc parse_volume_header(std::string const& header) {
+    VolumeDesc d;
+    std::istringstream ss(header.substr(3));
+    std::string word;
+    if (!(ss >> word) || word != "volume" || !(ss >> d.name)) {
+        throw std::invalid_argument("bad section header '" + header + "'");
+    }
+    while (ss >> word) {
+        size_t eq = word.find('=');
+        if (eq == std::string::npos) throw std::invalid_argument("bad volume option '" + word + "'");
+        std::string key = word.substr(0, eq);
+        std::string val = word.substr(eq + 1);
+        if      (key == "res")    d.res    = std::stoi(val);
+        else if (key == "extent") d.extent = std::stof(val);
+        else if (key == "format") d.format = parse_format(val);
+        else throw std::invalid_argument("unknown volume option '" + key + "'");
+    }
+    if (d.format != gfx::TextureFormat::R16F && d.format != gfx::TextureFormat::R32F) {
+        throw std::invalid_argument("volume '" + d.name + "' must be r16f or r32f");
+    }
+    if (d.res < 2 || d.res > 512) throw std::invalid_argument("bad volume res in '" + header + "'");
+    return d;
+}
+
+
+struct ImageDesc {
+    std::string     name;
+    std::string     path;
+    gfx::FilterMode filter = gfx::FilterMode::Linear;
+    gfx::WrapMode   wrap   = gfx::WrapMode::Clamp;
 };
 
 
+// "---image <name> <file> [filter=nearest|linear|mips] [wrap=clamp|repeat|mirror]"
+// makes an image file, relative to the shader, readable as channel <name>.
+// the section has no code. files are decoded in the background, the channel
+// is black until then, and files that did not change are not decoded again
+// on reload
+ImageDesc parse_image_header(std::string const& header, std::string const& dir) {
+    ImageDesc d;
+    std::istringstream ss(header.substr(3));
+    std::string word;
+    if (!(ss >> word) || word != "image" || !(ss >> d.name >> d.path)) {
+        throw std::invalid_argument("bad section header '" + header + "'");
+    }
+    if (d.path[0] != '/') d.path = dir + d.path;
+    while (ss >> word) {
+        size_t eq = word.find('=');
+        if (eq == std::string::npos) throw std::invalid_argument("bad image option '" + word + "'");
+        std::string key = word.substr(0, eq);
+        std::string val = word.substr(eq + 1);
+        if (key == "filter") {
+            if      (val == "nearest") d.filter = gfx::FilterMode::Nearest;
+            else if (val == "linear")  d.filter = gfx::FilterMode::Linear;
+            else if (val == "mips")    d.filter = gfx::FilterMode::Trilinear;
+            else throw std::invalid_argument("unknown filter '" + val + "'");
+        }
+        else if (key == "wrap") {
+            if      (val == "clamp")  d.wrap = gfx::WrapMode::Clamp;
+            else if (val == "repeat") d.wrap = gfx::WrapMode::Repeat;
+            else if (val == "mirror") d.wrap = gfx::WrapMode::MirrowedRepeat;
+            else throw std::invalid_argument("unknown wrap '" + val + "'");
+        }
+        else throw std::invalid_argument("unknown image option '" + key + "'");
+    }
+    return d;
+}
+
+
+// whether code has nothing but whitespace and comments
+bool is_blank(std::string const& code) {
+    for (size_t i = 0; i < code.size(); ++i) {
+        if (code.compare(i, 2, "//") == 0) i = std::min(code.find('\n', i), code.size());
+        else if (code.compare(i, 2, "/*") == 0) i = std::min(code.find("*/", i + 2), code.size()) + 1;
+        else if (!isspace((unsigned char) code[i])) return false;
+    }
+    return true;
+}
+
+
+// the code before the first "---" line is a pass with a plain header. if it
+// is only blank lines and comments, it is ignored.
+// a plain "---" starts a pass that writes channel <index> and reads the
+// channels 0 to 3, like in the old fixed chain.
+// "---pass <name> [in=<a>,<b>,...] [out=<a>,<b>,...] [size=<ratio>] [format=<format>] [stats] [mips]"
+// declares a pass explicitly. its inputs are bound to iChannel0, iChannel1, ...
+// in the given order and its output channel defaults to the pass name.
+// a pass with several outputs writes them at once as gl_FragData[0],
+// gl_FragData[1], ... they share size and format, and iHistory is the first.
+// with stats, the outputs' min, max, mean and non-finite count are reduced
+// on the GPU, and passes reading it as input k get them as iStatsK, along
+// with iHistogramK (a log2 luminance histogram, the stats in the last texel).
+// with mips, the outputs are sampled trilinearly and their mip chains are
+// rebuilt after every draw, so readers can downsample cheaply or pick a
+// level with textureLod(iChannelK, uv, lod).
+// "---compute <name> ..." takes the same options but declares a compute
+// shader, run once per output pixel in 16x16 work groups. it gets the pixel
+// as gl_GlobalInvocationID.xy and writes output k with imageStore to iOutK.
+// compute passes need GL 4.3 and have no cost mode variant.
+// "---native <name> <library> ..." takes the same options, but the pass is
+// rendered on the CPU by the fiddle_native_render() of a shared library (see
+// native.hpp), looked up next to the shader and then on the library path.
+// the section's code is the GLSL version of it, which is used instead if the
+// library doesn't load or with --no-native. it has a single float output.
+PassDesc parse_pass_header(std::string const& header, int index) {
+    PassDesc d;
+    std::istringstream ss(header.size() > 3 ? header.substr(3) : std::string());
+    std::string word;
+    if (!(ss >> word)) {
+        d.name = std::to_string(index);
+        d.outputs = { d.name };
+        for (int i = 0; i < 4; ++i) d.inputs.emplace_back(std::to_string(i));
+        d.implicit_inputs = true;
+        return d;
+    }
+    if ((word != "pass" && word != "compute" && word != "native") || !(ss >> d.name) ||
+        (word == "native" && !(ss >> d.library))) {
+        throw std::invalid_argument("bad section header '" + header + "'");
+    }
+    d.compute = word == "compute";
+    if (d.compute && !gfx::has_compute()) {
+        throw std::invalid_argument("compute pass '" + d.name + "' needs GL 4.3");
+    }
+    d.outputs = { d.name };
+    while (ss >> word) {
+        if (word == "stats") {
+            d.stats = true;
+            continue;
+        }
+        if (word == "mips") {
+            d.mips = true;
+            continue;
+        }
+        size_t eq = word.find('=');
+        if (eq == std::string::npos) throw std::invalid_argument("bad pass option '" + word + "'");
+        std::string key = word.substr(0, eq);
+        std::string val = word.substr(eq + 1);
+        if (key == "in" || key == "out") {
+            std::vector<std::string>& names = key == "in" ? d.inputs : d.outputs;
+            names.clear();
+            std::istringstream vs(val);
+            std::string name;
+            while (std::getline(vs, name, ',')) names.emplace_back(name);
+            if (names.size() > gfx::Framebuffer::MAX_COLORS) {
+                throw std::invalid_argument("too many channels in '" + word + "'");
+            }
+        }
+        else if (key == "size")   d.ratio  = std::stof(val);
+        else if (key == "format") d.format = parse_format(val);
+        else throw std::invalid_argument("unknown pass option '" + key + "'");
+    }
+    if (!d.library.empty() && (d.outputs.size() != 1 || (d.format != gfx::TextureFormat::RGBA32F &&
+                                                         d.format != gfx::TextureFormat::RGBA16F))) {
+        throw std::invalid_argument("native pass '" + d.name + "' needs one rgba16f or rgba32f output");
+    }
+    return d;
+}
+
+
+// the compiler's messages, with line numbers relative to the section
+void print_shader_log(const char* msg, int prelines) {
+    while (*msg) {
+        const char* c = msg;
+        while (*c && *c != '0') ++c;
+        while (*c && *c == '0') ++c;
+        while (*c && (*c < '0' || *c > '9')) ++c;
+        char* d;
+        int line = strtol(c, &d, 10);
+        c = d;
+        while (*d && *d != '\n') ++d;
+        printf("%d%.*s\n", line - prelines, int(d - c), c);
+        if (*d == '\n') ++d;
+        msg = d;
+    }
+}
+
+
+void App::free_passes() {
+    for (Pass& pass : m_passes) {
+        delete pass.shader;
+        delete pass.cost_shader;
+        delete pass.cost;
+        delete pass.timer;
+        if (pass.library) dlclose(pass.library);
+    }
+    for (Channel& c : m_channels) {
+        if (c.image < 0) delete c.texture;
+        delete c.history;
+        delete c.stats;
+    }
+    m_images->clear();
+    for (Volume& vol : m_volumes) {
+        delete vol.shader;
+        delete vol.texture;
+    }
+    m_volumes.clear();
+    m_passes.clear();
+    m_channels.clear();
+    m_schedule.clear();
+    m_output = -1;
+}
+
+
 void App::load_shader() {
     printf("loading shader...\n");
     m_clear_channels = true;
@@ -314,14 +1463,18 @@ void App::load_shader() {
         return;
     }
 
-    for (gfx::Shader*& s : m_shaders) {
-        delete s;
-        s = nullptr;
-    }
+    free_passes();
 
     try {
+        std::vector<PassDesc>    descs;
+        std::vector<std::string> codes;
+        std::vector<VolumeDesc>  volume_descs;
+        std::vector<std::string> volume_codes;
+        std::vector<ImageDesc>   image_descs;
+        std::string path = m_path;
+        std::string dir  = path.substr(0, path.find_last_of('/') + 1);
         Parser parser(file);
-        for (int i = 0; i < 4; ++i) {
+        while (!parser.done()) {
             std::string code = parser.parse_shader([this](Variable var) {
                 auto it = std::find_if(m_variables.begin(), m_variables.end(), [&var](auto& v) {
                     return v.name == var.name;
@@ -334,67 +1487,433 @@ void App::load_shader() {
                 }
                 else m_variables.emplace_back(var);
             });
-            if (code.empty()) break;
+            if (parser.header().compare(0, 8, "---image") == 0) {
+                image_descs.emplace_back(parse_image_header(parser.header(), dir));
+                continue;
+            }
+            if (code.empty() || (parser.header().empty() && is_blank(code))) continue;
+            if (parser.header().compare(0, 9, "---volume") == 0) {
+                volume_descs.emplace_back(parse_volume_header(parser.header()));
+                volume_codes.emplace_back(code);
+                continue;
+            }
+            descs.emplace_back(parse_pass_header(parser.header(), descs.size()));
+            codes.emplace_back(code);
+        }
+
+        // resolve channel names
+        auto find_channel = [this](std::string const& name) {
+            for (int i = 0; i < (int) m_channels.size(); ++i) {
+                if (m_channels[i].name == name) return i;
+            }
+            return -1;
+        };
+        for (PassDesc const& d : descs) {
+            if (d.outputs.empty()) throw std::invalid_argument("pass '" + d.name + "' has no output");
+            m_passes.push_back({ d.name });
+            Pass& pass = m_passes.back();
+            for (std::string const& name : d.outputs) {
+                if (find_channel(name) >= 0) {
+                    throw std::invalid_argument("channel '" + name + "' is written twice");
+                }
+                m_channels.push_back({ name, d.ratio, d.format });
+                m_channels.back().mips = d.mips;
+                pass.outputs.emplace_back(m_channels.size() - 1);
+                if (d.stats) m_channels.back().stats = new reduce::Target;
+            }
+            pass.output  = pass.outputs[0];
+            pass.compute = d.compute;
+            pass.timer   = gfx::GpuTimer::create();
+            if (d.library.empty() || !m_options.native) continue;
+            // without a slash, dlopen would only search the library path
+            std::string local = (dir.empty() ? "./" : dir) + d.library;
+            pass.library = dlopen(local.c_str(), RTLD_NOW | RTLD_LOCAL);
+            if (!pass.library) pass.library = dlopen(d.library.c_str(), RTLD_NOW | RTLD_LOCAL);
+            if (pass.library) {
+                pass.native = (native::RenderFunc) dlsym(pass.library, "fiddle_native_render");
+            }
+            if (!pass.native) {
+                printf("pass %s: %s, using the GLSL code\n", d.name.c_str(),
+                       pass.library ? "no fiddle_native_render" : dlerror());
+                continue;
+            }
+            if (!m_tiles) m_tiles = tiles::Pool::create();
+        }
+        for (ImageDesc const& d : image_descs) {
+            if (find_channel(d.name) >= 0) {
+                throw std::invalid_argument("channel '" + d.name + "' is written twice");
+            }
+            m_channels.push_back({ d.name });
+            Channel& c = m_channels.back();
+            c.format  = gfx::TextureFormat::RGBA;
+            c.image   = m_images->load(d.path, d.filter, d.wrap);
+            c.texture = m_images->get(c.image);
+        }
+        // offline renders must not start with blank images
+        if (m_options.offline()) m_images->finish();
+        for (int i = 0; i < (int) descs.size(); ++i) {
+            for (std::string const& name : descs[i].inputs) {
+                int c = find_channel(name);
+                if (c < 0) {
+                    // the old chain could read channels no pass writes
+                    if (!descs[i].implicit_inputs) {
+                        throw std::invalid_argument("pass '" + descs[i].name +
+                                                    "' reads unknown channel '" + name + "'");
+                    }
+                    m_channels.push_back({ name });
+                    c = m_channels.size() - 1;
+                }
+                m_passes[i].inputs.emplace_back(c);
+            }
+        }
 
-            int prelines = 10;
+        // the bake shader evaluates map() at the voxel centers of slice iSlice
+        for (int i = 0; i < (int) volume_descs.size(); ++i) {
+            VolumeDesc const& d = volume_descs[i];
+            m_volumes.push_back({ d.name, d.extent });
+            Volume& vol = m_volumes.back();
+            vol.texture = gfx::Texture3D::create(d.format, d.res, d.res, d.res);
             std::stringstream ss;
-            ss << R"(#version 130
+            ss << "#version 130\n";
+            ss << "uniform float iSlice;\n";
+            ss << "uniform float iRes;\n";
+            ss << "uniform float iExtent;\n";
+            int prelines = 4;
+            for (Variable const& v : m_variables) {
+                ss << "uniform float _" << v.name << ";\n";
+                ++prelines;
+            }
+            ss << volume_codes[i];
+            ss << "\nvoid main() {\n"
+                  "    vec3 p = (vec3(gl_FragCoord.xy, iSlice + 0.5) / iRes * 2.0 - 1.0) * iExtent;\n"
+                  "    gl_FragColor = vec4(map(p));\n"
+                  "}\n";
+            std::string code = ss.str();
+            try {
+                vol.shader = gfx::Shader::create(nullptr, code.c_str());
+            }
+            catch (std::runtime_error const& e) {
+                printf("volume %s:\n", d.name.c_str());
+                print_shader_log(e.what(), prelines);
+            }
+        }
+
+        for (int i = 0; i < (int) m_passes.size(); ++i) {
+            static const char preamble[] = R"(
 uniform vec3 iPos;
 uniform mat3 iEye;
 uniform float iTime;
 uniform float iFrame;
+uniform float iPreview;
 uniform vec2 iResolution;
-uniform sampler2D iChannel0;
-uniform sampler2D iChannel1;
-uniform sampler2D iChannel2;
-uniform sampler2D iChannel3;
+uniform vec2 iTileResolution;
+uniform vec2 iOffset;
+uniform sampler2D iHistory;
+uniform vec3 iPrevPos;
+uniform mat3 iPrevEye;
+// pixel position of world point p in the previous frame, for a camera with
+// ray direction iEye * vec3(uv, focal). z is the distance to the previous eye
+vec3 reproject(vec3 p, float focal) {
+    vec3 d = transpose(iPrevEye) * (p - iPrevPos);
+    if (d.z <= 0.0) return vec3(-1.0);
+    vec2 uv = d.xy / d.z * focal + vec2(1.0, iResolution.y / iResolution.x);
+    return vec3(uv * iResolution.x * 0.5, length(p - iPrevPos));
+}
+// whether a reprojected point was on screen and not occluded, given the
+// depth the pass stored for that pixel last frame
+bool reproject_valid(vec3 r, float prev_depth, float tolerance) {
+    return all(greaterThanEqual(r.xy, vec2(0.0))) && all(lessThan(r.xy, iResolution)) &&
+           abs(r.z - prev_depth) <= tolerance * r.z;
+}
+// distance from a volume baked over [-extent, extent]^3. trilinear filtering
+// can overshoot by a voxel diagonal, and outside the cube the distance to the
+// clamped point is subtracted, so the result never exceeds the true distance
+float volume_dist(sampler3D v, float extent, vec3 p) {
+    vec3 q = clamp(p, -extent, extent);
+    float voxel = 2.0 * extent / float(textureSize(v, 0).x);
+    float d = texture(v, q / (2.0 * extent) + 0.5).r - sqrt(3.0) * voxel;
+    return d - length(p - q);
+}
 )";
+            Pass& pass = m_passes[i];
+            int prelines = std::count(std::begin(preamble), std::end(preamble), '\n');
+            std::stringstream ss;
+            if (pass.compute) {
+                ss << "#version 430\n";
+                ss << "layout(local_size_x = " << COMPUTE_GROUP << ", local_size_y = " << COMPUTE_GROUP << ") in;";
+                for (int k = 0; k < (int) pass.outputs.size(); ++k) {
+                    ss << "\nlayout(" << image_format(m_channels[pass.outputs[k]].format)
+                       << ") uniform image2D iOut" << k << ";";
+                }
+                prelines += 1 + pass.outputs.size();
+            }
+            else ss << "#version 130";
+            ss << preamble;
+            int channel_count = std::max<int>(4, m_passes[i].inputs.size());
+            for (int k = 0; k < channel_count; ++k) {
+                ss << "uniform sampler2D iChannel" << k << ";\n";
+                ss << "uniform vec4 iStats" << k << ";\n";
+                ss << "uniform sampler2D iHistogram" << k << ";\n";
+                prelines += 3;
+            }
+            for (int k = 0; k < (int) m_volumes.size(); ++k) {
+                ss << "uniform sampler3D iVolume" << k << ";\n";
+                ss << "float iVolumeDist" << k << "(vec3 p) { return volume_dist(iVolume" << k << ", "
+                   << std::to_string(m_volumes[k].extent) << ", p); }\n";
+                prelines += 2;
+            }
             for (Variable const& v : m_variables) {
                 ss << "uniform float _" << v.name << ";\n";
                 ++prelines;
             }
-            ss << code;
-            code = ss.str();
+            std::string head = ss.str();
+            ss << "void iCostTick() {}\n";
+            ++prelines;
+            ss << codes[i];
+            std::string code = ss.str();
 
             try {
-                m_shaders[i] = gfx::Shader::create(nullptr, code.c_str());
+                if (pass.compute) pass.shader = gfx::Shader::create_compute(code.c_str());
+                else pass.shader = gfx::Shader::create(nullptr, code.c_str());
                 printf("done.\n");
             }
             catch (std::runtime_error const& e) {
-                const char* msg = e.what();
-                while (*msg) {
-                    const char* c = msg;
-                    while (*c && *c != '0') ++c;
-                    while (*c && *c == '0') ++c;
-                    while (*c && (*c < '0' || *c > '9')) ++c;
-                    char* d;
-                    int line = strtol(c, &d, 10);
-                    c = d;
-                    while (*d && *d != '\n') ++d;
-                    printf("%d%.*s\n", line - prelines, int(d - c), c);
-                    if (*d == '\n') ++d;
-                    msg = d;
+                printf("pass %s:\n", m_passes[i].name.c_str());
+                print_shader_log(e.what(), prelines);
+            }
+
+            // in cost mode, passes that tick get a variant whose output is the tick count
+            if (m_cost && pass.shader && !pass.compute && codes[i].find("iCostTick") != std::string::npos) {
+                std::string cost_code = head +
+                    "float iCost_ = 0.0;\n"
+                    "void iCostTick() { iCost_ += 1.0; }\n"
+                    "#define main iCostMain\n" + codes[i] +
+                    "\n#undef main\n"
+                    "void main() { iCostMain(); gl_FragColor = vec4(iCost_, 0.0, 0.0, 1.0); }\n";
+                try {
+                    m_passes[i].cost_shader = gfx::Shader::create(nullptr, cost_code.c_str());
+                }
+                catch (std::runtime_error const&) {
+                    printf("pass %s: cannot instrument for cost mode\n", m_passes[i].name.c_str());
                 }
             }
         }
     }
     catch (std::logic_error const& e) {
         printf("ERROR: %s\n", e.what());
-        for (gfx::Shader*& s : m_shaders) {
-            delete s;
-            s = nullptr;
+        free_passes();
+    }
+
+    m_reproject = std::any_of(m_passes.begin(), m_passes.end(), [](Pass const& p) {
+        return p.shader && p.shader->has_uniform("iPrevPos");
+    });
+    schedule_passes();
+    init_channels();
+}
+
+
+void App::schedule_passes() {
+    m_schedule.clear();
+    m_output = -1;
+
+    // the last pass that compiled is what we see
+    int out = -1;
+    for (int i = 0; i < (int) m_passes.size(); ++i) {
+        if (m_passes[i].shader) out = i;
+    }
+    if (out < 0) return;
+    m_output = m_passes[out].output;
+
+    std::vector<int> writer(m_channels.size(), -1);
+    for (int i = 0; i < (int) m_passes.size(); ++i) {
+        if (!m_passes[i].shader) continue;
+        for (int c : m_passes[i].outputs) writer[c] = i;
+    }
+
+    // only inputs the shader actually samples count as dependencies
+    for (Pass& pass : m_passes) {
+        pass.sampled.clear();
+        if (!pass.shader) continue;
+        for (int k = 0; k < (int) pass.inputs.size(); ++k) {
+            if (pass.shader->has_uniform("iChannel" + std::to_string(k))) {
+                pass.sampled.emplace_back(pass.inputs[k]);
+            }
         }
-        return;
+        pass.seen.assign(pass.sampled.size(), -1);
+    }
+    auto deps = [&](int p) {
+        std::vector<int> d;
+        for (int c : m_passes[p].sampled) {
+            int w = writer[c];
+            if (w >= 0 && w != p) d.emplace_back(w);
+        }
+        return d;
+    };
+
+    // cull passes the output doesn't depend on
+    std::vector<bool> live(m_passes.size());
+    std::vector<int>  stack = { out };
+    int live_count = 0;
+    while (!stack.empty()) {
+        int p = stack.back();
+        stack.pop_back();
+        if (live[p]) continue;
+        live[p] = true;
+        ++live_count;
+        for (int d : deps(p)) stack.emplace_back(d);
+    }
+
+    // topological order, ties are broken by declaration order.
+    // passes in a cycle see each other's output from the previous frame
+    std::vector<bool> done(m_passes.size());
+    while ((int) m_schedule.size() < live_count) {
+        int next = -1;
+        for (int p = 0; p < (int) m_passes.size() && next < 0; ++p) {
+            if (!live[p] || done[p]) continue;
+            auto d = deps(p);
+            if (std::all_of(d.begin(), d.end(), [&](int q) { return done[q]; })) next = p;
+        }
+        if (next < 0) {
+            for (int p = 0; p < (int) m_passes.size() && next < 0; ++p) {
+                if (live[p] && !done[p]) next = p;
+            }
+        }
+        done[next] = true;
+        m_schedule.emplace_back(next);
     }
+}
+
 
+void usage(const char* name) {
+    printf("usage: %s [options] shader_file\n"
+           "  -o <file>          output image (.png or .tif), a printf pattern for --frames\n"
+           "  --poster <w>x<h>   render a still of the given size tile by tile\n"
+           "  --tile <n>         poster tile size (default 256)\n"
+           "  --frames <a>:<b>   render the animation frames a to b\n"
+           "  --fps <f>          frame rate of animations, recordings and --fixed (default 30)\n"
+           "  --fixed            advance time by exactly 1/fps per frame\n"
+           "  --start <t>        time of frame 0 (default 0)\n"
+           "  --end <t>          quit once the time passes t\n"
+           "  --size <w>x<h>     animation frame size (default 800x600)\n"
+           "  --samples <n>      frames rendered per poster tile or animation frame (default 1)\n"
+           "  --record <target>  record the output from the start, F9 toggles recording.\n"
+           "                     shot_%%04d.png, out.y4m, out.rgba or |command (y4m on stdin)\n"
+           "  --workers <n>      render posters and animations in n processes\n"
+           "  --log <file>       write the session's camera, variables, reloads and time\n"
+           "  --replay <file>    replay a session log headless at --size and time its frames\n"
+           "  --camera <file>    camera path, K adds a key and P plays it (default camera.path)\n"
+           "  --play             fly the camera path headless at --size and time its frames,\n"
+           "                     redrawing every pass each frame\n"
+           "  --timings <file>   write the frame times of --replay or --play as csv\n"
+           "  --max-p95 <ms>     fail if the 95th percentile frame time is above\n"
+           "  --no-native        render native passes with their GLSL code\n", name);
 }
 
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        printf("usage: %s shader_file\n", argv[0]);
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : "";
+        bool ok = true;
+        if (a == "-o") {
+            opts.output = v;
+            ++i;
+        }
+        else if (a == "--poster") {
+            ok = sscanf(v, "%dx%d", &opts.poster.x, &opts.poster.y) == 2;
+            ++i;
+        }
+        else if (a == "--tile") {
+            opts.tile = atoi(v);
+            ++i;
+        }
+        else if (a == "--frames") {
+            ok = sscanf(v, "%d:%d", &opts.first, &opts.last) == 2;
+            ++i;
+        }
+        else if (a == "--fps") {
+            opts.fps = atof(v);
+            ++i;
+        }
+        else if (a == "--fixed") opts.fixed = true;
+        else if (a == "--start") {
+            opts.start = atof(v);
+            ++i;
+        }
+        else if (a == "--end") {
+            opts.end = atof(v);
+            ++i;
+        }
+        else if (a == "--size") {
+            ok = sscanf(v, "%dx%d", &opts.size.x, &opts.size.y) == 2;
+            ++i;
+        }
+        else if (a == "--samples") {
+            opts.samples = std::max(1, atoi(v));
+            ++i;
+        }
+        else if (a == "--record") {
+            opts.record = v;
+            ++i;
+        }
+        else if (a == "--log") {
+            opts.log = v;
+            ++i;
+        }
+        else if (a == "--replay") {
+            opts.replay = v;
+            ++i;
+        }
+        else if (a == "--camera") {
+            opts.camera = v;
+            ++i;
+        }
+        else if (a == "--play") opts.play = true;
+        else if (a == "--timings") {
+            opts.timings = v;
+            ++i;
+        }
+        else if (a == "--max-p95") {
+            opts.max_p95 = atof(v);
+            ++i;
+        }
+        else if (a == "--workers") {
+            opts.workers = atoi(v);
+            ++i;
+        }
+        else if (a == "--worker") opts.worker = true;
+        else if (a == "--no-native") opts.native = false;
+        else if (a[0] != '-' && !opts.path) opts.path = argv[i];
+        else ok = false;
+        if (!ok) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    bool frames = opts.last >= opts.first;
+    if (!opts.path || opts.fps <= 0 || (opts.offline() && !opts.output) ||
+        (opts.poster.x > 0 && (frames || opts.tile <= 0)) ||
+        (frames && (!strchr(opts.output, '%') || opts.size.x <= 0 || opts.size.y <= 0)) ||
+        (opts.workers > 0 && !opts.offline()) ||
+        (opts.replay && (opts.offline() || opts.log || opts.play)) ||
+        (opts.play && opts.offline())) {
+        usage(argv[0]);
         return 0;
     }
-    App a(argv[1]);
-    return fx::run(a);
+    if (opts.workers > 0 && !opts.worker) return farm::run(opts, argc, argv);
+
+    fx::Config config;
+    if (opts.poster.x > 0) {
+        config.width    = opts.tile;
+        config.height   = opts.tile;
+        config.headless = true;
+    }
+    else if (frames || opts.replay || opts.play) {
+        config.width    = opts.size.x;
+        config.height   = opts.size.y;
+        config.headless = true;
+    }
+    App a(opts);
+    return fx::run(a, config);
 }
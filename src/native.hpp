@@ -0,0 +1,56 @@
+#pragma once
+// the interface between the fiddle and native passes: kernels in shared
+// libraries that render a pass on the CPU. a library exports
+//
+//   extern "C" void fiddle_native_render(native::Frame const* f, native::Tile const* t);
+//
+// which fills one tile with RGBA floats. it is called for many tiles at once
+// from several threads, so it must not keep state between calls.
+// this header is included by the libraries, keep it free of dependencies
+#include <cstring>
+
+
+namespace native {
+
+
+enum { VERSION = 1 };
+
+
+// the uniforms of a GLSL pass
+struct Frame {
+    int                version;        // VERSION
+    float              time;           // iTime
+    float              frame;          // iFrame
+    float              resolution[2];  // iResolution, the whole poster for tiled renders
+    float              offset[2];      // iOffset, of the output in the poster
+    float              pos[3];         // iPos
+    float              eye[9];         // iEye, column major
+    int                variable_count;
+    char const* const* variable_names; // as in the shader file, without the $
+    float const*       variable_values;
+};
+
+
+// a rectangle of the output. pixel x, y starts at rgba[(y * stride + x) * 4]
+// relative to the tile, rows bottom up like gl_FragCoord
+struct Tile {
+    int    x, y;  // of the bottom left pixel in the output
+    int    w, h;
+    float* rgba;
+    int    stride; // pixels between rows
+};
+
+
+typedef void (*RenderFunc)(Frame const* f, Tile const* t);
+
+
+// the value of a variable, or def if the shader file doesn't use it
+inline float variable(Frame const& f, const char* name, float def) {
+    for (int i = 0; i < f.variable_count; ++i) {
+        if (strcmp(f.variable_names[i], name) == 0) return f.variable_values[i];
+    }
+    return def;
+}
+
+
+} // namespace
@@ -0,0 +1,31 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cmath>
+
+
+struct Options {
+    const char* path    = nullptr;
+    const char* output  = nullptr;      // poster image, or a printf pattern for frames
+    glm::ivec2  size    = { 800, 600 }; // frame size of animation renders
+    glm::ivec2  poster  = { 0, 0 };     // poster size, zero when not rendering a poster
+    int         tile    = 256;
+    int         samples = 1;            // frames rendered per poster tile or animation frame
+    int         first   = 0;            // animation frames, none if last < first
+    int         last    = -1;
+    float       fps     = 30;           // of animations, recordings and the fixed clock
+    bool        fixed   = false;        // advance time by 1 / fps per frame
+    float       start   = 0;            // time of frame 0
+    float       end     = INFINITY;     // quit once time passes this
+    const char* record  = nullptr;      // recording target, see record::Recorder
+    const char* log     = nullptr;      // session log to write
+    const char* replay  = nullptr;      // session log to replay headless
+    const char* timings = nullptr;      // csv of the replay's frame times
+    float       max_p95 = 0;            // fail the replay if the 95th percentile frame time is above
+    const char* camera  = nullptr;      // camera path file
+    bool        play    = false;        // fly the camera path headless and time the frames
+    int         workers = 0;            // worker processes to spread the render over
+    bool        worker  = false;        // take jobs from stdin instead of doing everything
+    bool        native  = true;         // run native passes on the CPU, else their GLSL code
+
+    bool offline() const { return poster.x > 0 || last >= first; }
+};
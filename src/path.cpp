@@ -0,0 +1,83 @@
+#include "path.hpp"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <algorithm>
+
+
+namespace {
+
+
+template<class T>
+T catmull_rom(T const& p0, T const& p1, T const& p2, T const& p3, float u) {
+    float u2 = u * u;
+    float u3 = u2 * u;
+    return 0.5f * (p1 * 2.0f +
+                   (p2 - p0) * u +
+                   (p0 * 2.0f - p1 * 5.0f + p2 * 4.0f - p3) * u2 +
+                   (p1 * 3.0f - p0 - p2 * 3.0f + p3) * u3);
+}
+
+
+} // namespace
+
+
+bool CameraPath::load(const char* filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) return false;
+    m_keys.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream ss(line);
+        Key k;
+        if (!(ss >> k.time >> k.pos.x >> k.pos.y >> k.pos.z >> k.ang.x >> k.ang.y)) {
+            printf("path: bad key '%s'\n", line.c_str());
+            continue;
+        }
+        m_keys.emplace_back(k);
+    }
+    std::stable_sort(m_keys.begin(), m_keys.end(), [](Key const& a, Key const& b) {
+        return a.time < b.time;
+    });
+    return true;
+}
+
+
+bool CameraPath::save(const char* filename) const {
+    FILE* f = fopen(filename, "w");
+    if (!f) return false;
+    fprintf(f, "# time pos.x pos.y pos.z ang.x ang.y\n");
+    for (Key const& k : m_keys) {
+        fprintf(f, "%g %f %f %f %f %f\n", k.time, k.pos.x, k.pos.y, k.pos.z, k.ang.x, k.ang.y);
+    }
+    return fclose(f) == 0;
+}
+
+
+void CameraPath::add(glm::vec3 const& pos, glm::vec2 const& ang, float spacing) {
+    float time = m_keys.empty() ? 0 : m_keys.back().time + spacing;
+    m_keys.push_back({ time, pos, ang });
+}
+
+
+void CameraPath::sample(float time, glm::vec3& pos, glm::vec2& ang) const {
+    if (m_keys.empty()) return;
+    int n = m_keys.size();
+    int i = 0;
+    while (i < n - 2 && m_keys[i + 1].time <= time) ++i;
+    Key const& k1 = m_keys[i];
+    Key const& k2 = m_keys[std::min(i + 1, n - 1)];
+    if (n == 1 || time <= k1.time || k2.time <= k1.time) {
+        pos = (time <= k1.time ? k1 : k2).pos;
+        ang = (time <= k1.time ? k1 : k2).ang;
+        return;
+    }
+    // the end keys are repeated to close the spline
+    Key const& k0 = m_keys[std::max(i - 1, 0)];
+    Key const& k3 = m_keys[std::min(i + 2, n - 1)];
+    float u = std::min((time - k1.time) / (k2.time - k1.time), 1.0f);
+    pos = catmull_rom(k0.pos, k1.pos, k2.pos, k3.pos, u);
+    ang = catmull_rom(k0.ang, k1.ang, k2.ang, k3.ang, u);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+
+// camera keyframes for flythroughs. the file has one key per line,
+// "<time> <pos.x> <pos.y> <pos.z> <ang.x> <ang.y>", and playback follows a
+// Catmull-Rom spline through the positions and angles
+class CameraPath {
+public:
+    struct Key {
+        float     time;
+        glm::vec3 pos;
+        glm::vec2 ang;
+    };
+
+    bool load(const char* filename);
+    bool save(const char* filename) const;
+
+    // append a key the given number of seconds after the last one
+    void add(glm::vec3 const& pos, glm::vec2 const& ang, float spacing = 2);
+
+    bool  empty() const { return m_keys.empty(); }
+    int   size() const { return m_keys.size(); }
+    float start() const { return m_keys.front().time; }
+    float end() const { return m_keys.back().time; }
+
+    // the camera at the given time, clamped to the path
+    void sample(float time, glm::vec3& pos, glm::vec2& ang) const;
+
+private:
+    std::vector<Key> m_keys;
+};
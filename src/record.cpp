@@ -0,0 +1,238 @@
+#include "record.hpp"
+#include "image.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <csignal>
+#include <cmath>
+#include <deque>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+
+namespace record {
+
+namespace {
+
+
+enum class Format { Png, Y4m, Raw };
+
+
+bool has_extension(std::string const& name, const char* ext) {
+    size_t n = strlen(ext);
+    return name.size() >= n && name.compare(name.size() - n, n, ext) == 0;
+}
+
+
+uint8_t clamp_u8(float f) {
+    return uint8_t(std::min(std::max(f, 0.0f), 255.0f) + 0.5f);
+}
+
+
+class RecorderImpl : public Recorder {
+public:
+    ~RecorderImpl() override {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_work.notify_all();
+        for (std::thread& t : m_threads) t.join();
+        if (m_pipe) pclose(m_file);
+        else if (m_file) fclose(m_file);
+    }
+
+    bool init(const char* target, int width, int height, float fps) {
+        m_target = target;
+        m_width  = width;
+        m_height = height;
+        if (target[0] == '|') {
+            m_format = Format::Y4m;
+            m_pipe   = true;
+            // a command that quits early should fail the recording, not kill us
+            signal(SIGPIPE, SIG_IGN);
+            m_file = popen(target + 1, "w");
+        }
+        else if (has_extension(target, ".png")) {
+            m_format = Format::Png;
+            if (!strchr(target, '%')) {
+                printf("record: png sequences need a frame number pattern like shot_%%04d.png\n");
+                return false;
+            }
+        }
+        else if (has_extension(target, ".y4m")) {
+            m_format = Format::Y4m;
+            m_file   = fopen(target, "wb");
+        }
+        else if (has_extension(target, ".rgba")) {
+            m_format = Format::Raw;
+            m_file   = fopen(target, "wb");
+        }
+        else {
+            printf("record: unknown format '%s'\n", target);
+            return false;
+        }
+        if (m_format != Format::Png && !m_file) {
+            printf("record: cannot open %s\n", target);
+            return false;
+        }
+        if (m_format == Format::Y4m) {
+            fprintf(m_file, "YUV4MPEG2 W%d H%d F%d:1000 Ip A1:1 C444\n",
+                    width, height, int(std::round(fps * 1000)));
+        }
+
+        int n = std::thread::hardware_concurrency();
+        int count = std::min(std::max(n - 1, 1), 8);
+        m_max_pending = count * 2;
+        for (int i = 0; i < count; ++i) m_threads.emplace_back(&RecorderImpl::work, this);
+        return true;
+    }
+
+    bool push(void const* rgba) override {
+        std::vector<uint8_t> data;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_space.wait(lock, [this] { return m_pending < m_max_pending || m_failed; });
+            if (m_failed) return false;
+            ++m_pending;
+            if (!m_free.empty()) {
+                data = std::move(m_free.back());
+                m_free.pop_back();
+            }
+        }
+        data.resize(m_width * m_height * 4);
+        memcpy(data.data(), rgba, data.size());
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back({ m_next_index++, std::move(data) });
+        }
+        m_work.notify_one();
+        return true;
+    }
+
+private:
+    struct Frame {
+        int                  index;
+        std::vector<uint8_t> data;
+    };
+
+    void work() {
+        std::vector<uint8_t> out;
+        for (;;) {
+            Frame f;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_work.wait(lock, [this] { return !m_queue.empty() || m_quit; });
+                if (m_queue.empty()) return;
+                f = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            bool ok = m_format == Format::Png ? write_png(f) : write_stream(f, out);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_free.push_back(std::move(f.data));
+                --m_pending;
+                if (!ok) m_failed = true;
+            }
+            m_space.notify_all();
+        }
+    }
+
+    // frames come bottom up
+    uint8_t const* row(Frame const& f, int y) const {
+        return &f.data[(m_height - 1 - y) * m_width * 4];
+    }
+
+    bool write_png(Frame const& f) {
+        char path[4096];
+        snprintf(path, sizeof(path), m_target.c_str(), f.index);
+        image::Writer* w = image::Writer::create(path, m_width, m_height);
+        bool ok = w != nullptr;
+        for (int y = 0; y < m_height && ok; ++y) ok = w->write_rows(row(f, y), 1);
+        delete w;
+        if (!ok) printf("record: cannot write %s\n", path);
+        return ok;
+    }
+
+    // convert in parallel, write in frame order
+    bool write_stream(Frame const& f, std::vector<uint8_t>& out) {
+        int n = m_width * m_height;
+        if (m_format == Format::Raw) {
+            out.resize(n * 4);
+            for (int y = 0; y < m_height; ++y) {
+                std::copy(row(f, y), row(f, y) + m_width * 4, &out[y * m_width * 4]);
+            }
+        }
+        else {
+            // BT.601, studio range
+            static const char header[] = "FRAME\n";
+            int h = sizeof(header) - 1;
+            out.resize(h + n * 3);
+            std::copy(header, header + h, out.begin());
+            uint8_t* py = &out[h];
+            uint8_t* pu = py + n;
+            uint8_t* pv = pu + n;
+            for (int y = 0; y < m_height; ++y) {
+                uint8_t const* p = row(f, y);
+                for (int x = 0; x < m_width; ++x, p += 4) {
+                    float r = p[0] * (1.0f / 255.0f);
+                    float g = p[1] * (1.0f / 255.0f);
+                    float b = p[2] * (1.0f / 255.0f);
+                    *py++ = clamp_u8( 16.0f +  65.481f * r + 128.553f * g +  24.966f * b);
+                    *pu++ = clamp_u8(128.0f -  37.797f * r -  74.203f * g + 112.000f * b);
+                    *pv++ = clamp_u8(128.0f + 112.000f * r -  93.786f * g -  18.214f * b);
+                }
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(m_write_mutex);
+        m_written.wait(lock, [&] { return m_next_write == f.index; });
+        bool ok = fwrite(out.data(), out.size(), 1, m_file) == 1;
+        if (!ok) printf("record: cannot write %s\n", m_target.c_str());
+        ++m_next_write;
+        lock.unlock();
+        m_written.notify_all();
+        return ok;
+    }
+
+    std::string                       m_target;
+    Format                            m_format;
+    int                               m_width;
+    int                               m_height;
+    FILE*                             m_file = nullptr;
+    bool                              m_pipe = false;
+
+    std::vector<std::thread>          m_threads;
+    std::mutex                        m_mutex;
+    std::condition_variable           m_work;
+    std::condition_variable           m_space;
+    std::deque<Frame>                 m_queue;
+    std::vector<std::vector<uint8_t>> m_free;          // recycled frame buffers
+    int                               m_pending     = 0; // queued or being encoded
+    int                               m_max_pending = 0;
+    int                               m_next_index  = 0;
+    bool                              m_failed      = false;
+    bool                              m_quit        = false;
+
+    std::mutex                        m_write_mutex;
+    std::condition_variable           m_written;
+    int                               m_next_write = 0;
+};
+
+
+} // namespace
+
+
+Recorder* Recorder::create(const char* target, int width, int height, float fps) {
+    auto r = new RecorderImpl;
+    if (r->init(target, width, height, fps)) return r;
+    delete r;
+    return nullptr;
+}
+
+
+} // namespace
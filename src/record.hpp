@@ -0,0 +1,23 @@
+#pragma once
+
+
+namespace record {
+
+
+// encodes captured frames on a pool of threads, so the render thread only
+// hands over a copy. the target picks the format:
+//   "shot_%04d.png"   png sequence, one file per frame
+//   "out.y4m"         YUV 4:4:4 video
+//   "out.rgba"        raw RGBA frames, top to bottom
+//   "|command"        y4m video piped into a command, e.g. "|ffmpeg -i - out.mp4"
+struct Recorder {
+    static Recorder* create(const char* target, int width, int height, float fps);
+    // waits until every frame is written
+    virtual ~Recorder() {}
+    // queue a bottom-up RGBA frame. blocks only while the encoders are
+    // several frames behind. false once writing has failed
+    virtual bool push(void const* rgba) = 0;
+};
+
+
+} // namespace
@@ -0,0 +1,231 @@
+#include "reduce.hpp"
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+
+namespace reduce {
+
+namespace {
+
+
+enum { MAX_POINTS = 1 << 16 };
+
+
+const char* QUAD_VS = R"(#version 130
+void main() { gl_Position = gl_Vertex; }
+)";
+
+
+// r = min, g = max, b = sum of the finite values, a = non-finite count
+const char* FOLD_FS = R"(#version 130
+uniform sampler2D src;
+uniform vec2 size;
+uniform float first;
+uniform float single;
+void main() {
+    ivec2 s = ivec2(size);
+    ivec2 base = ivec2(gl_FragCoord.xy) * 4;
+    vec4 r = vec4(1e30, -1e30, 0.0, 0.0);
+    for (int y = 0; y < 4; ++y)
+    for (int x = 0; x < 4; ++x) {
+        ivec2 p = base + ivec2(x, y);
+        if (p.x >= s.x || p.y >= s.y) continue;
+        vec4 c = texelFetch(src, p, 0);
+        if (first > 0.5) {
+            if (any(isnan(c)) || any(isinf(c))) {
+                r.a += 1.0;
+                continue;
+            }
+            float v = single > 0.5 ? c.r : dot(c.rgb, vec3(0.2126, 0.7152, 0.0722));
+            c = vec4(v, v, v, 0.0);
+        }
+        r = vec4(min(r.r, c.r), max(r.g, c.g), r.b + c.b, r.a + c.a);
+    }
+    gl_FragColor = r;
+}
+)";
+
+
+const char* RESOLVE_FS = R"(#version 130
+uniform sampler2D src;
+uniform float total;
+void main() {
+    vec4 r = texelFetch(src, ivec2(0), 0);
+    float n = total - r.a;
+    gl_FragColor = n > 0.0 ? vec4(r.rg, r.b / n, r.a) : vec4(0.0, 0.0, 0.0, r.a);
+}
+)";
+
+
+// one point per sampled pixel, into the bin of its log2 luminance
+const char* SCATTER_VS = R"(#version 130
+uniform sampler2D src;
+uniform vec2 size;
+uniform float step;
+uniform float single;
+uniform float ev_min;
+uniform float ev_max;
+uniform float bins;
+void main() {
+    int cols = int(ceil(size.x / step));
+    ivec2 p = ivec2(gl_VertexID % cols, gl_VertexID / cols) * int(step);
+    vec4 c = texelFetch(src, p, 0);
+    gl_PointSize = 1.0;
+    if (any(isnan(c)) || any(isinf(c))) {
+        gl_Position = vec4(2.0, 2.0, 0.0, 1.0);
+        return;
+    }
+    float v = single > 0.5 ? c.r : dot(c.rgb, vec3(0.2126, 0.7152, 0.0722));
+    float ev = v > 0.0 ? log2(v) : ev_min;
+    float bin = clamp(floor((ev - ev_min) / (ev_max - ev_min) * bins), 0.0, bins - 1.0);
+    gl_Position = vec4((bin + 0.5) / bins * 2.0 - 1.0, 0.0, 0.0, 1.0);
+}
+)";
+
+
+const char* SCATTER_FS = R"(#version 130
+void main() { gl_FragColor = vec4(1.0, 0.0, 0.0, 0.0); }
+)";
+
+
+} // namespace
+
+
+float Stats::percentile(float p) const {
+    float sum = 0;
+    for (int i = 0; i < BINS; ++i) {
+        sum += histogram[i];
+        if (sum >= p) return EV_MIN + (i + 1) * (EV_MAX - EV_MIN) / BINS;
+    }
+    return EV_MAX;
+}
+
+
+Target::~Target() {
+    for (gfx::Texture2D* t : chain) delete t;
+    delete result;
+    delete readback;
+}
+
+
+Reducer::Reducer() {
+    m_framebuffer = gfx::Framebuffer::create();
+
+    m_quad_vb = gfx::VertexBuffer::create(gfx::BufferHint::StaticDraw);
+    m_quad    = gfx::VertexArray::create();
+    m_quad->set_primitive_type(gfx::PrimitiveType::TriangleStrip);
+    m_quad->set_attribute(0, m_quad_vb, gfx::ComponentType::Float, 2, false, 0, sizeof(glm::vec2));
+    std::vector<glm::vec2> v = { { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 } };
+    m_quad_vb->init_data(v);
+    m_quad->set_count(v.size());
+
+    // the scatter shader only needs gl_VertexID, but attribute 0 must be an array
+    m_points_vb = gfx::VertexBuffer::create(gfx::BufferHint::StaticDraw);
+    m_points    = gfx::VertexArray::create();
+    m_points->set_primitive_type(gfx::PrimitiveType::Points);
+    m_points_vb->init_data(std::vector<uint8_t>(MAX_POINTS));
+    m_points->set_attribute(0, m_points_vb, gfx::ComponentType::Uint8, 1, false, 0, 1);
+
+    m_fold    = gfx::Shader::create(QUAD_VS, FOLD_FS);
+    m_resolve = gfx::Shader::create(QUAD_VS, RESOLVE_FS);
+    m_scatter = gfx::Shader::create(SCATTER_VS, SCATTER_FS);
+    m_scatter->set_uniform("ev_min", EV_MIN);
+    m_scatter->set_uniform("ev_max", EV_MAX);
+    m_scatter->set_uniform("bins", float(BINS));
+}
+
+
+Reducer::~Reducer() {
+    delete m_framebuffer;
+    delete m_quad;
+    delete m_quad_vb;
+    delete m_points;
+    delete m_points_vb;
+    delete m_fold;
+    delete m_resolve;
+    delete m_scatter;
+}
+
+
+bool Reducer::reduce(Target& t, gfx::Texture2D* tex, bool single) {
+    glm::ivec2 size = { tex->get_width(), tex->get_height() };
+    if (!t.result) {
+        t.result   = gfx::Texture2D::create(gfx::TextureFormat::RGBA32F, BINS + 1, 1);
+        t.readback = gfx::Readback::create();
+    }
+    // no point in reducing what couldn't be read back
+    if (t.readback->full()) return false;
+    if (t.size != size) {
+        t.size = size;
+        for (gfx::Texture2D* c : t.chain) delete c;
+        t.chain.clear();
+        glm::ivec2 s = size;
+        do {
+            s = (s + 3) / 4;
+            t.chain.emplace_back(gfx::Texture2D::create(gfx::TextureFormat::RGBA32F, s.x, s.y));
+        } while (s.x > 1 || s.y > 1);
+    }
+
+    // fold down the chain
+    gfx::Texture2D* src = tex;
+    for (gfx::Texture2D* dst : t.chain) {
+        m_fold->set_uniform("src", src);
+        m_fold->set_uniform("size", glm::vec2(src->get_width(), src->get_height()));
+        m_fold->set_uniform("first", float(src == tex));
+        m_fold->set_uniform("single", float(single));
+        m_framebuffer->attach_color(dst);
+        m_rs.viewport = { 0, 0, 0, 0 };
+        gfx::draw(m_rs, m_fold, m_quad, m_framebuffer);
+        src = dst;
+    }
+
+    m_framebuffer->attach_color(t.result);
+    gfx::clear({}, m_framebuffer);
+
+    // histogram, from at most MAX_POINTS evenly spread pixels
+    float step = std::max(1.0f, std::ceil(std::sqrt(float(size.x) * size.y / MAX_POINTS)));
+    int   cols = std::ceil(size.x / step);
+    int   rows = std::ceil(size.y / step);
+    m_scatter->set_uniform("src", tex);
+    m_scatter->set_uniform("size", glm::vec2(size));
+    m_scatter->set_uniform("step", step);
+    m_scatter->set_uniform("single", float(single));
+    m_points->set_count(std::min(cols * rows, int(MAX_POINTS)));
+    gfx::RenderState rs;
+    rs.viewport             = { 0, 0, BINS, 1 };
+    rs.blend_enabled        = true;
+    rs.blend_func_src_rgb   = gfx::BlendFunc::One;
+    rs.blend_func_dst_rgb   = gfx::BlendFunc::One;
+    rs.blend_func_src_alpha = gfx::BlendFunc::One;
+    rs.blend_func_dst_alpha = gfx::BlendFunc::One;
+    gfx::draw(rs, m_scatter, m_points, m_framebuffer);
+
+    m_resolve->set_uniform("src", t.chain.back());
+    m_resolve->set_uniform("total", float(size.x) * size.y);
+    m_rs.viewport = { BINS, 0, 1, 1 };
+    gfx::draw(m_rs, m_resolve, m_quad, m_framebuffer);
+
+    return t.readback->start(t.result, gfx::TextureFormat::RGBA32F);
+}
+
+
+void Reducer::poll(Target& t) {
+    if (!t.readback) return;
+    int w, h;
+    while (auto data = static_cast<glm::vec4 const*>(t.readback->map(w, h))) {
+        float sum = 0;
+        for (int i = 0; i < BINS; ++i) sum += data[i].r;
+        for (int i = 0; i < BINS; ++i) t.stats.histogram[i] = sum > 0 ? data[i].r / sum : 0;
+        glm::vec4 r = data[BINS];
+        t.stats.min       = r.x;
+        t.stats.max       = r.y;
+        t.stats.mean      = r.z;
+        t.stats.nonfinite = r.w;
+        t.stats.valid     = true;
+        t.readback->unmap();
+    }
+}
+
+
+} // namespace
@@ -0,0 +1,69 @@
+#pragma once
+#include "gfx.hpp"
+#include <array>
+#include <vector>
+
+
+namespace reduce {
+
+
+enum { BINS = 64 };
+constexpr float EV_MIN = -10; // histogram range in log2 luminance
+constexpr float EV_MAX = 6;
+
+
+struct Stats {
+    float                   min       = 0;
+    float                   max       = 0;
+    float                   mean      = 0;
+    float                   nonfinite = 0; // NaN or Inf pixels
+    std::array<float, BINS> histogram = {}; // fraction of pixels per bin
+    bool                    valid     = false;
+
+    // log2 luminance below which the given fraction of pixels lies
+    float percentile(float p) const;
+};
+
+
+// what it takes to reduce one texture
+struct Target {
+    ~Target();
+    std::vector<gfx::Texture2D*> chain;            // each level a quarter of the last, down to 1x1
+    gfx::Texture2D*              result   = nullptr; // BINS histogram texels, then min, max, mean, non-finite
+    gfx::Readback*               readback = nullptr;
+    glm::ivec2                   size     = { 0, 0 };
+    Stats                        stats;
+};
+
+
+// reduces textures to a few numbers on the GPU. fragment passes fold 4x4
+// blocks through a chain of RGBA32F textures, and points scattered with
+// additive blending build the histogram. only the result texture is read
+// back, asynchronously, so the stats lag a few frames behind
+class Reducer {
+public:
+    Reducer();
+    ~Reducer();
+
+    // queue the reduction of a texture. single: stats of the red channel
+    // instead of the luminance. false if the target's readbacks are all
+    // still in flight
+    bool reduce(Target& t, gfx::Texture2D* tex, bool single);
+
+    // pick up finished results
+    void poll(Target& t);
+
+private:
+    gfx::RenderState   m_rs;
+    gfx::Framebuffer*  m_framebuffer;
+    gfx::VertexBuffer* m_quad_vb;
+    gfx::VertexArray*  m_quad;
+    gfx::VertexBuffer* m_points_vb;
+    gfx::VertexArray*  m_points;
+    gfx::Shader*       m_fold;
+    gfx::Shader*       m_resolve;
+    gfx::Shader*       m_scatter;
+};
+
+
+} // namespace
@@ -0,0 +1,150 @@
+#include "session.hpp"
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+
+namespace session {
+
+namespace {
+
+
+const char    MAGIC[]  = "SFLOG";
+const uint8_t VERSION  = 1;
+
+// record tags
+enum : uint8_t { VARIABLE = 'v', FRAME = 'f' };
+enum : uint8_t { RELOAD = 1, CLEAR = 2 };
+
+
+template<class T>
+void put(FILE* f, T const& v) { fwrite(&v, sizeof(T), 1, f); }
+
+template<class T>
+bool get(FILE* f, T& v) { return fread(&v, sizeof(T), 1, f) == 1; }
+
+
+} // namespace
+
+
+LogWriter::~LogWriter() {
+    if (m_file) fclose(m_file);
+}
+
+
+bool LogWriter::open(const char* filename) {
+    m_file = fopen(filename, "wb");
+    if (!m_file) return false;
+    fwrite(MAGIC, 1, sizeof(MAGIC) - 1, m_file);
+    put(m_file, VERSION);
+    return true;
+}
+
+
+bool LogWriter::write(Frame const& frame) {
+    std::vector<std::pair<uint16_t, float>> changed;
+    for (auto const& v : frame.variables) {
+        auto it = m_ids.find(v.first);
+        if (it == m_ids.end()) {
+            int id = m_values.size();
+            it = m_ids.emplace(v.first, id).first;
+            m_values.emplace_back(NAN);
+            uint8_t len = std::min<size_t>(v.first.size(), 255);
+            put(m_file, VARIABLE);
+            put(m_file, uint16_t(id));
+            put(m_file, len);
+            fwrite(v.first.data(), 1, len, m_file);
+        }
+        if (m_values[it->second] == v.second) continue;
+        m_values[it->second] = v.second;
+        changed.emplace_back(it->second, v.second);
+    }
+
+    put(m_file, FRAME);
+    put(m_file, frame.time);
+    put(m_file, frame.pos);
+    put(m_file, frame.ang);
+    put(m_file, uint8_t((frame.reload ? RELOAD : 0) | (frame.clear ? CLEAR : 0)));
+    put(m_file, uint16_t(changed.size()));
+    for (auto const& c : changed) {
+        put(m_file, c.first);
+        put(m_file, c.second);
+    }
+    return !ferror(m_file);
+}
+
+
+LogReader::~LogReader() {
+    if (m_file) fclose(m_file);
+}
+
+
+bool LogReader::open(const char* filename) {
+    m_file = fopen(filename, "rb");
+    if (!m_file) return false;
+    char    magic[sizeof(MAGIC) - 1];
+    uint8_t version;
+    if (fread(magic, 1, sizeof(magic), m_file) != sizeof(magic) ||
+        memcmp(magic, MAGIC, sizeof(magic)) != 0 ||
+        !get(m_file, version) || version != VERSION)
+    {
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+
+bool LogReader::read(Frame& frame) {
+    uint8_t tag;
+    while (get(m_file, tag)) {
+        if (tag == VARIABLE) {
+            uint16_t id;
+            uint8_t  len;
+            if (!get(m_file, id) || !get(m_file, len)) return false;
+            std::string name(len, '\0');
+            if (fread(&name[0], 1, len, m_file) != len) return false;
+            if (id >= m_names.size()) m_names.resize(id + 1);
+            m_names[id] = name;
+            continue;
+        }
+        if (tag != FRAME) return false;
+
+        uint8_t  flags;
+        uint16_t count;
+        if (!get(m_file, frame.time) || !get(m_file, frame.pos) || !get(m_file, frame.ang) ||
+            !get(m_file, flags) || !get(m_file, count)) return false;
+        frame.reload = flags & RELOAD;
+        frame.clear  = flags & CLEAR;
+        frame.variables.clear();
+        for (int i = 0; i < count; ++i) {
+            uint16_t id;
+            float    val;
+            if (!get(m_file, id) || !get(m_file, val) || id >= m_names.size()) return false;
+            frame.variables.emplace_back(m_names[id], val);
+        }
+        return true;
+    }
+    return false;
+}
+
+
+Stats compute_stats(std::vector<float> times) {
+    Stats s = {};
+    s.frames = times.size();
+    if (times.empty()) return s;
+    std::sort(times.begin(), times.end());
+    auto at = [&times](float p) { return times[std::min<size_t>(times.size() * p, times.size() - 1)]; };
+    s.mean   = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+    s.median = at(0.5f);
+    s.p95    = at(0.95f);
+    s.p99    = at(0.99f);
+    s.max    = times.back();
+    return s;
+}
+
+
+} // namespace
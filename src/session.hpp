@@ -0,0 +1,64 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <map>
+
+
+namespace session {
+
+
+// the inputs of one interactive frame
+struct Frame {
+    float                                      time;
+    glm::vec3                                  pos;
+    glm::vec2                                  ang;
+    bool                                       reload = false; // the shader was reloaded before the frame
+    bool                                       clear  = false; // the channels were cleared by hand
+    std::vector<std::pair<std::string, float>> variables;
+};
+
+
+// compact binary session log in native byte order. variable names are
+// stored once, frames only carry the variable values that changed
+class LogWriter {
+public:
+    ~LogWriter();
+    bool open(const char* filename);
+    bool write(Frame const& frame);
+
+private:
+    FILE*                      m_file = nullptr;
+    std::map<std::string, int> m_ids;
+    std::vector<float>         m_values; // last written, by id
+};
+
+
+class LogReader {
+public:
+    ~LogReader();
+    bool open(const char* filename);
+    // the next frame with the variables that changed. false at the end
+    bool read(Frame& frame);
+
+private:
+    FILE*                    m_file = nullptr;
+    std::vector<std::string> m_names; // by id
+};
+
+
+struct Stats {
+    int   frames;
+    float mean;
+    float median;
+    float p95;
+    float p99;
+    float max;
+};
+
+// frame times in milliseconds
+Stats compute_stats(std::vector<float> times);
+
+
+} // namespace
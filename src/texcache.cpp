@@ -0,0 +1,301 @@
+#include "texcache.hpp"
+#include <SDL2/SDL_image.h>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+
+
+namespace texcache {
+
+namespace {
+
+
+enum {
+    UPLOAD_BYTES = 8 << 20,   // per poll
+    KEEP_BYTES   = 256 << 20, // of textures no key refers to
+};
+
+
+uint64_t fnv1a(uint8_t const* p, size_t n, uint64_t h) {
+    for (size_t i = 0; i < n; ++i) h = (h ^ p[i]) * 0x100000001b3ull;
+    return h;
+}
+
+
+bool read_file(std::string const& path, std::vector<uint8_t>& data) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data.resize(std::max(size, 0L));
+    bool ok = size >= 0 && fread(data.data(), 1, data.size(), f) == data.size();
+    fclose(f);
+    return ok;
+}
+
+
+class CacheImpl : public Cache {
+public:
+    CacheImpl() {
+        uint8_t black[] = { 0, 0, 0, 0 };
+        m_blank  = gfx::Texture2D::create(gfx::TextureFormat::RGBA, 1, 1, black);
+        m_thread = std::thread(&CacheImpl::work, this);
+    }
+
+    ~CacheImpl() override {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_work.notify_all();
+        m_thread.join();
+        for (auto& p : m_textures) delete p.second.texture;
+        delete m_blank;
+    }
+
+    int load(std::string const& path, gfx::FilterMode filter, gfx::WrapMode wrap) override {
+        int key = m_requests.size();
+        m_requests.push_back({ path, filter, wrap });
+        ++m_pending;
+        queue(key, false);
+        return key;
+    }
+
+    gfx::Texture2D* get(int key) const override {
+        gfx::Texture2D* t = m_requests[key].texture;
+        return t ? t : m_blank;
+    }
+
+    void clear() override {
+        m_requests.clear();
+        m_pending = 0;
+        ++m_generation;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.clear();
+    }
+
+    void poll() override {
+        std::deque<Result> done;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            done.swap(m_done);
+        }
+        for (Result& r : done) {
+            if (r.generation != m_generation) continue;
+            Request& q = m_requests[r.key];
+            if (!r.ok) {
+                printf("texcache: cannot load %s\n", q.path.c_str());
+                q.done = true;
+                --m_pending;
+                continue;
+            }
+            q.hash     = r.hash;
+            q.has_hash = true;
+            if (m_textures.count(r.hash)) continue;
+            if (r.pixels.empty()) {
+                // evicted since the worker looked
+                queue(r.key, true);
+                continue;
+            }
+            Entry& e  = m_textures[r.hash];
+            e.texture = gfx::Texture2D::create(gfx::TextureFormat::RGBA, r.width, r.height, nullptr, q.filter, q.wrap);
+            e.bytes   = r.pixels.size();
+            e.mips    = q.filter == gfx::FilterMode::Trilinear;
+            m_uploads.push_back({ r.hash, 0, std::move(r.pixels) });
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_known.insert(r.hash);
+        }
+
+        // a slice of rows at a time, so a large atlas is spread over frames
+        size_t budget = UPLOAD_BYTES;
+        while (!m_uploads.empty() && budget > 0) {
+            Upload& u = m_uploads.front();
+            Entry&  e = m_textures[u.hash];
+            size_t pitch = e.texture->get_width() * 4;
+            int rows = std::min<size_t>(e.texture->get_height() - u.row, std::max<size_t>(1, budget / pitch));
+            e.texture->set_rows(u.row, rows, &u.pixels[u.row * pitch]);
+            u.row += rows;
+            budget -= std::min(budget, rows * pitch);
+            if (u.row < e.texture->get_height()) break;
+            if (e.mips) e.texture->generate_mipmaps();
+            e.ready = true;
+            m_uploads.pop_front();
+        }
+
+        for (Request& q : m_requests) {
+            if (q.done || !q.has_hash) continue;
+            auto it = m_textures.find(q.hash);
+            if (it == m_textures.end() || !it->second.ready) continue;
+            q.texture = it->second.texture;
+            q.done    = true;
+            --m_pending;
+        }
+        if (m_pending == 0) evict();
+    }
+
+    void finish() override {
+        for (;;) {
+            poll();
+            if (m_pending == 0) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+private:
+    struct Request {
+        std::string     path;
+        gfx::FilterMode filter;
+        gfx::WrapMode   wrap;
+        gfx::Texture2D* texture  = nullptr;
+        uint64_t        hash     = 0;
+        bool            has_hash = false;
+        bool            done     = false; // loaded or failed
+    };
+
+    struct Job {
+        int         key;
+        uint32_t    generation;
+        std::string path;
+        uint64_t    seed;   // filter and wrap, so they are part of the hash
+        bool        decode; // even if the hash is known
+    };
+
+    struct Result {
+        int                  key;
+        uint32_t             generation;
+        bool                 ok     = false;
+        uint64_t             hash   = 0;
+        int                  width  = 0;
+        int                  height = 0;
+        std::vector<uint8_t> pixels; // bottom row first, empty if the hash was known
+    };
+
+    struct Entry {
+        gfx::Texture2D* texture = nullptr;
+        size_t          bytes   = 0;
+        bool            mips    = false;
+        bool            ready   = false;  // fully uploaded
+        uint32_t        used    = 0;      // the last generation a key referred to it
+    };
+
+    struct Upload {
+        uint64_t             hash;
+        int                  row;
+        std::vector<uint8_t> pixels;
+    };
+
+    void queue(int key, bool decode) {
+        Request const& q = m_requests[key];
+        uint64_t seed = 0xcbf29ce484222325ull;
+        uint8_t flavor[] = { uint8_t(q.filter), uint8_t(q.wrap) };
+        seed = fnv1a(flavor, sizeof(flavor), seed);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back({ key, m_generation, q.path, seed, decode });
+        }
+        m_work.notify_one();
+    }
+
+    void work() {
+        std::vector<uint8_t> file;
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_work.wait(lock, [this] { return !m_queue.empty() || m_quit; });
+                if (m_quit) return;
+                job = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+            Result r { job.key, job.generation };
+            if (read_file(job.path, file)) {
+                r.hash = fnv1a(file.data(), file.size(), job.seed);
+                bool known;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    known = m_known.count(r.hash) > 0;
+                }
+                r.ok = (known && !job.decode) || decode(file, r);
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done.push_back(std::move(r));
+        }
+    }
+
+    static bool decode(std::vector<uint8_t> const& file, Result& r) {
+        SDL_Surface* s = IMG_Load_RW(SDL_RWFromConstMem(file.data(), file.size()), 1);
+        if (!s) return false;
+        SDL_Surface* c = SDL_ConvertSurfaceFormat(s, SDL_PIXELFORMAT_RGBA32, 0);
+        SDL_FreeSurface(s);
+        if (!c) return false;
+        r.width  = c->w;
+        r.height = c->h;
+        r.pixels.resize(c->w * c->h * 4);
+        for (int y = 0; y < c->h; ++y) {
+            memcpy(&r.pixels[(c->h - 1 - y) * c->w * 4], static_cast<uint8_t*>(c->pixels) + y * c->pitch, c->w * 4);
+        }
+        SDL_FreeSurface(c);
+        return true;
+    }
+
+    // least recently used first, until the unused textures fit into KEEP_BYTES
+    void evict() {
+        size_t unused = 0;
+        for (Request const& q : m_requests) {
+            if (q.texture) m_textures[q.hash].used = m_generation;
+        }
+        for (auto const& p : m_textures) {
+            if (p.second.ready && p.second.used != m_generation) unused += p.second.bytes;
+        }
+        while (unused > KEEP_BYTES) {
+            auto oldest = m_textures.end();
+            for (auto it = m_textures.begin(); it != m_textures.end(); ++it) {
+                if (!it->second.ready || it->second.used == m_generation) continue;
+                if (oldest == m_textures.end() || it->second.used < oldest->second.used) oldest = it;
+            }
+            unused -= oldest->second.bytes;
+            delete oldest->second.texture;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_known.erase(oldest->first);
+            }
+            m_textures.erase(oldest);
+        }
+    }
+
+    gfx::Texture2D*                       m_blank;
+    std::vector<Request>                  m_requests;     // by key
+    int                                   m_pending    = 0; // requests not done
+    uint32_t                              m_generation = 0; // bumped by clear()
+    std::unordered_map<uint64_t, Entry>   m_textures;     // by content hash
+    std::deque<Upload>                    m_uploads;
+
+    std::thread                           m_thread;
+    std::mutex                            m_mutex;
+    std::condition_variable               m_work;
+    std::deque<Job>                       m_queue;
+    std::deque<Result>                    m_done;
+    std::unordered_set<uint64_t>          m_known;        // hashes with a texture
+    bool                                  m_quit = false;
+};
+
+
+} // namespace
+
+
+Cache* Cache::create() {
+    return new CacheImpl;
+}
+
+
+} // namespace
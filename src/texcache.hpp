@@ -0,0 +1,31 @@
+#pragma once
+#include "gfx.hpp"
+#include <string>
+
+
+namespace texcache {
+
+
+// loads image files into textures without stalling the render thread. a
+// worker thread reads, hashes and decodes the files, and poll() uploads the
+// pixels a slice of rows at a time. textures are kept by content hash across
+// clear(), so after a reload an unchanged file is read and hashed again, but
+// neither decoded nor uploaded
+struct Cache {
+    static Cache* create();
+    virtual ~Cache() {}
+    // start loading a file. the key is valid until clear()
+    virtual int load(std::string const& path, gfx::FilterMode filter, gfx::WrapMode wrap) = 0;
+    // the texture of a key, bottom row first. 1x1 black while the file is
+    // loading or if it failed
+    virtual gfx::Texture2D* get(int key) const = 0;
+    // forget all keys. unused textures are evicted once the cache gets too big
+    virtual void clear() = 0;
+    // pick up decoded images and upload some of them. once per frame
+    virtual void poll() = 0;
+    // poll until every key is loaded or failed
+    virtual void finish() = 0;
+};
+
+
+} // namespace
@@ -0,0 +1,141 @@
+#include "tiles.hpp"
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+
+namespace tiles {
+
+namespace {
+
+
+// a run of tiles [begin, end) in one word, so that the owner taking from the
+// front and thieves taking from the back agree through a single CAS
+uint64_t pack(uint32_t begin, uint32_t end) { return uint64_t(begin) << 32 | end; }
+uint32_t run_begin(uint64_t r) { return r >> 32; }
+uint32_t run_end(uint64_t r) { return uint32_t(r); }
+
+
+class PoolImpl : public Pool {
+public:
+    PoolImpl(int threads) : m_runs(threads) {
+        for (int i = 1; i < threads; ++i) m_threads.emplace_back(&PoolImpl::work, this, i);
+    }
+
+    ~PoolImpl() override {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_start.notify_all();
+        for (std::thread& t : m_threads) t.join();
+    }
+
+    void run(int width, int height, int size, std::function<void(int, int, int, int)> const& func) override {
+        int cols  = (width + size - 1) / size;
+        int rows  = (height + size - 1) / size;
+        int count = cols * rows;
+        int n     = m_runs.size();
+        // tiles are numbered row by row, so a run is a band of the image
+        for (int i = 0; i < n; ++i) {
+            m_runs[i].store(pack(int64_t(count) * i / n, int64_t(count) * (i + 1) / n));
+        }
+        m_width  = width;
+        m_height = height;
+        m_size   = size;
+        m_cols   = cols;
+        m_func   = &func;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_generation;
+            m_busy = n - 1;
+        }
+        m_start.notify_all();
+        process(0);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_busy == 0; });
+    }
+
+private:
+    void work(int index) {
+        uint32_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_start.wait(lock, [&] { return m_generation != seen || m_quit; });
+                if (m_quit) return;
+                seen = m_generation;
+            }
+            process(index);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                --m_busy;
+            }
+            m_done.notify_one();
+        }
+    }
+
+    void process(int index) {
+        int tile;
+        while ((tile = pop(index)) >= 0 || (tile = steal(index)) >= 0) {
+            int x = tile % m_cols * m_size;
+            int y = tile / m_cols * m_size;
+            (*m_func)(x, y, std::min(m_size, m_width - x), std::min(m_size, m_height - y));
+        }
+    }
+
+    // the front of the thread's own run
+    int pop(int index) {
+        std::atomic<uint64_t>& run = m_runs[index];
+        uint64_t r = run.load();
+        while (run_begin(r) < run_end(r)) {
+            if (run.compare_exchange_weak(r, pack(run_begin(r) + 1, run_end(r)))) return run_begin(r);
+        }
+        return -1;
+    }
+
+    // the back of the next run that has tiles left
+    int steal(int index) {
+        int n = m_runs.size();
+        for (int k = 1; k < n; ++k) {
+            std::atomic<uint64_t>& run = m_runs[(index + k) % n];
+            uint64_t r = run.load();
+            while (run_begin(r) < run_end(r)) {
+                if (run.compare_exchange_weak(r, pack(run_begin(r), run_end(r) - 1))) return run_end(r) - 1;
+            }
+        }
+        return -1;
+    }
+
+    std::vector<std::atomic<uint64_t>> m_runs; // per thread
+    std::vector<std::thread>           m_threads;
+    std::mutex                         m_mutex;
+    std::condition_variable            m_start;
+    std::condition_variable            m_done;
+    uint32_t                           m_generation = 0; // bumped by each run
+    int                                m_busy       = 0; // threads still working on it
+    bool                               m_quit       = false;
+
+    // the current run
+    int                                m_width  = 0;
+    int                                m_height = 0;
+    int                                m_size   = 0;
+    int                                m_cols   = 0;
+    std::function<void(int, int, int, int)> const* m_func = nullptr;
+};
+
+
+} // namespace
+
+
+Pool* Pool::create(int threads) {
+    if (threads <= 0) threads = std::max<int>(1, std::thread::hardware_concurrency());
+    return new PoolImpl(threads);
+}
+
+
+} // namespace
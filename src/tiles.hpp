@@ -0,0 +1,21 @@
+#pragma once
+#include <functional>
+
+
+namespace tiles {
+
+
+// runs a function over the tiles of an image on all cores. each thread starts
+// on its own run of neighbouring tiles and, when that is done, steals tiles
+// from the end of the other runs, so expensive regions don't leave cores idle
+struct Pool {
+    // threads: 0 for one per core. the calling thread is one of them
+    static Pool* create(int threads = 0);
+    virtual ~Pool() {}
+    // call func(x, y, w, h) for the tiles of at most size x size pixels that
+    // cover width x height, and return once all are done
+    virtual void run(int width, int height, int size, std::function<void(int, int, int, int)> const& func) = 0;
+};
+
+
+} // namespace